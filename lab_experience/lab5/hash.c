@@ -11,15 +11,16 @@
 #define SHA256_IOC_GET_STATUS _IOR(SHA256_IOC_MAGIC, 1, int)
 #define SHA256_IOC_START_HASH _IOW(SHA256_IOC_MAGIC, 2, int)
 #define SHA256_IOC_RESET _IOW(SHA256_IOC_MAGIC, 3, int)
+#define SHA256_IOC_GET_INPUT_SIZE _IOR(SHA256_IOC_MAGIC, 4, int)
 
-#define inputBufferSize     1024
 #define outputBufferSize    32
 
 int main() {
     
     int fd;
     uint32_t id;
-    char input[inputBufferSize];
+    uint32_t inputSize;
+    char *input;
     uint8_t output[outputBufferSize];
     int read_bytes;
 
@@ -38,17 +39,33 @@ int main() {
     }
     printf("Device ID: %x\n", id);
 
+    // Ask the driver how large the device input window is
+    if (ioctl(fd, SHA256_IOC_GET_INPUT_SIZE, &inputSize) == -1) {
+        perror("Failed to get input window size");
+        close(fd);
+        return -1;
+    }
+
+    input = malloc(inputSize + 1);
+    if (input == NULL) {
+        perror("Failed to allocate the input buffer");
+        close(fd);
+        return -1;
+    }
+
     // Get input from the user
-    printf("Enter a string to hash: ");
-    fgets(input, sizeof(input), stdin);
+    printf("Enter a string to hash (up to %u bytes): ", inputSize);
+    fgets(input, inputSize + 1, stdin);
     input[strcspn(input, "\n")] = 0;    // Remove newline character if present
 
     // Write the input to the device
     if (write(fd, input, strlen(input)) < 0) {
         perror("Failed to write to the device");
+        free(input);
         close(fd);
         return -1;
     }
+    free(input);
 
     // Initiate the hashing process
     if (ioctl(fd, SHA256_IOC_START_HASH, NULL) == -1) {
@@ -0,0 +1,122 @@
+/**
+ ****************************************************************************************
+ * @file    sha256_trace.h
+ * @brief   Tracepoints of the request lifecycle of the SHA256 char device driver, for
+ *          correlating accelerator latency with scheduler and I/O events in ftrace and
+ *          perf. Disabled tracepoints cost a patched-out branch.
+ ****************************************************************************************
+ * @attention
+ * Included by sha_driver.c after its structure definitions. The ring buffer timestamps
+ * every event, sha256_complete also carries the job latency measured from the launch.
+ *
+ *   echo 1 > /sys/kernel/tracing/events/sha256/enable
+ *   perf trace -e 'sha256:*' ...
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM sha256
+
+#if !defined(SHA256_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define SHA256_TRACE_H
+
+#include <linux/tracepoint.h>
+
+#define show_req_kind(kind) \
+    __print_symbolic(kind, { REQ_PART, "part" }, { REQ_FINAL, "final" }, \
+                     { REQ_ABORT, "abort" }, { REQ_BATCH, "batch" })
+
+/* A file hands staged data to its queue, or a batch entry is taken up */
+TRACE_EVENT(sha256_submit,
+    TP_PROTO(struct sha256_queue *dev, struct sha256_ctx *ctx, int kind, size_t len),
+    TP_ARGS(dev, ctx, kind, len),
+    TP_STRUCT__entry(
+        __field(int, minor)
+        __field(int, queue)
+        __field(const void *, ctx)
+        __field(int, kind)
+        __field(size_t, len)
+    ),
+    TP_fast_assign(
+        __entry->minor = dev->sdev->minor;
+        __entry->queue = dev - dev->sdev->queues;
+        __entry->ctx = ctx;
+        __entry->kind = kind;
+        __entry->len = len;
+    ),
+    TP_printk("sha256%d q%d ctx=%p %s len=%zu", __entry->minor, __entry->queue, __entry->ctx,
+              show_req_kind(__entry->kind), __entry->len)
+);
+
+/* A bank is handed to the device */
+TRACE_EVENT(sha256_start,
+    TP_PROTO(struct sha256_queue *dev, int bank, u32 len, bool more),
+    TP_ARGS(dev, bank, len, more),
+    TP_STRUCT__entry(
+        __field(int, minor)
+        __field(int, queue)
+        __field(int, bank)
+        __field(u32, len)
+        __field(bool, more)
+    ),
+    TP_fast_assign(
+        __entry->minor = dev->sdev->minor;
+        __entry->queue = dev - dev->sdev->queues;
+        __entry->bank = bank;
+        __entry->len = len;
+        __entry->more = more;
+    ),
+    TP_printk("sha256%d q%d bank=%d len=%u%s", __entry->minor, __entry->queue, __entry->bank,
+              __entry->len, __entry->more ? " more" : "")
+);
+
+/* The device is done with a bank the driver launched */
+TRACE_EVENT(sha256_complete,
+    TP_PROTO(struct sha256_queue *dev, int bank, u64 latency_ns, bool slept, int rc),
+    TP_ARGS(dev, bank, latency_ns, slept, rc),
+    TP_STRUCT__entry(
+        __field(int, minor)
+        __field(int, queue)
+        __field(int, bank)
+        __field(u64, latency_ns)
+        __field(bool, slept)
+        __field(int, rc)
+    ),
+    TP_fast_assign(
+        __entry->minor = dev->sdev->minor;
+        __entry->queue = dev - dev->sdev->queues;
+        __entry->bank = bank;
+        __entry->latency_ns = latency_ns;
+        __entry->slept = slept;
+        __entry->rc = rc;
+    ),
+    TP_printk("sha256%d q%d bank=%d latency=%lluns %s rc=%d", __entry->minor, __entry->queue,
+              __entry->bank, __entry->latency_ns, __entry->slept ? "slept" : "spun", __entry->rc)
+);
+
+/* A digest is copied to user space */
+TRACE_EVENT(sha256_copyout,
+    TP_PROTO(struct sha256_queue *dev, struct sha256_ctx *ctx, size_t len),
+    TP_ARGS(dev, ctx, len),
+    TP_STRUCT__entry(
+        __field(int, minor)
+        __field(int, queue)
+        __field(const void *, ctx)
+        __field(size_t, len)
+    ),
+    TP_fast_assign(
+        __entry->minor = dev->sdev->minor;
+        __entry->queue = dev - dev->sdev->queues;
+        __entry->ctx = ctx;
+        __entry->len = len;
+    ),
+    TP_printk("sha256%d q%d ctx=%p len=%zu", __entry->minor, __entry->queue, __entry->ctx, __entry->len)
+);
+
+#endif /* SHA256_TRACE_H */
+
+/* This part must be outside the multi-read protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE sha256_trace
+#include <trace/define_trace.h>
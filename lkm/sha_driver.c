@@ -18,6 +18,26 @@
 #include <linux/platform_device.h>
 #include <linux/io.h>
 #include <linux/device.h>
+#include <linux/iopoll.h>
+#include <linux/mutex.h>
+#include <linux/rwsem.h>
+#include <linux/pci.h>
+#include <linux/interrupt.h>
+#include <linux/idr.h>
+#include <linux/smp.h>
+#include <linux/wait.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/uio.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/rculist.h>
+#include <linux/jhash.h>
+#include <crypto/sha2.h>
 
 /* Kernel Module Macro Definitions --------------------------------------------------- */
 
@@ -30,76 +50,632 @@
 #define SHA256_IOC_GET_STATUS _IOR(SHA256_IOC_MAGIC, 1, int)
 #define SHA256_IOC_START_HASH _IOW(SHA256_IOC_MAGIC, 2, int)
 #define SHA256_IOC_RESET _IOW(SHA256_IOC_MAGIC, 3, int)
+#define SHA256_IOC_GET_INPUT_SIZE _IOR(SHA256_IOC_MAGIC, 4, int)
+#define SHA256_IOC_HASH_BATCH _IOWR(SHA256_IOC_MAGIC, 5, struct sha256_batch)
+#define SHA256_IOC_SET_CACHE _IOW(SHA256_IOC_MAGIC, 6, int)
+#define SHA256_IOC_SET_FALLBACK _IOW(SHA256_IOC_MAGIC, 7, int)
+#define SHA256_IOC_SET_WEIGHT _IOW(SHA256_IOC_MAGIC, 8, int)
 
 /* Device Macros Definitions --------------------------------------------------------- */
 
-#define deviceEN            0x00000001
-#define inputBufferSize     1024
+#define deviceEN            0x00000001      // Start hashing the bank in deviceBANK
+#define deviceBANK          0x00000002
+#define deviceMORE          0x00000004      // More parts of the message follow, do not finalize
+#define deviceSELECT        0x00000008      // Map the bank in deviceBANK into the input window
+#define statusDONE(bank)    (0x1 << ((bank) * 4))
+#define statusBUSY(bank)    (0x2 << ((bank) * 4))
+#define jobTimeoutUs        1000000         // Longest wait for a single bank job
+#define maxSpinNs           50000           // Adaptive waits stop spinning once jobs average more than this
+#define pollSleepUs         20              // STATUS_REG poll interval after the spin window, without a vector
+#define latencyShift        3               // Weight of a new job in the latency average, 1/8
+#define defaultInputSize    1024            // Window size of device models without a capability register
+#define maxInputSize        0x10000
 #define outputBufferSize    32
+#define maxBatchEntries     4096            // Largest SHA256_IOC_HASH_BATCH request
+#define maxDevices          8               // Minors reserved for /dev/sha256<n>
+#define irqDONE             0x00000001      // IRQ_REG: interrupt per completed bank
+
+#define latencyBuckets      32              // log2 ns buckets, bucket b holds [2^b, 2^(b+1)) ns
+#define depthBuckets        16              // Queue depth seen on entry, the last bucket collects the rest
+#define stageWindows        16              // Input windows a file stages before handing them to the worker
+#define cacheMaxKey         256             // Longest message answered from the digest cache
+#define calibrationRounds   8               // Timed runs per size, the fastest one counts
+#define maxWeight           64              // Largest SHA256_IOC_SET_WEIGHT
+#define smallBurst          8               // Small requests served in a row while bulk ones wait
+#define batchDepth          16              // Small batch entries queued at once by one file
+
+#define SHA256_PCI_VENDOR_ID    0x1234      // QEMU
+#define SHA256_PCI_DEVICE_ID    0x5256
 
 /* Device Register Map --------------------------------------------------------------- */
 
 #define ID_REG      0x0000
+#define CAP_REG     0x0004          // Input window size in bytes
 #define CTRL_REG    0x0008
 #define STATUS_REG  0x000C 
 #define INPUT_REG   0x0010
-#define OUTPUT_REG  0x0410
+#define OUTPUT_REG(dev) (INPUT_REG + (dev)->input_size)     // Output follows the input window
+#define LEN_REG(dev)    (OUTPUT_REG(dev) + outputBufferSize)
+#define IRQ_REG(dev)    (LEN_REG(dev) + 0x04)
+#define QUEUES_REG(dev) (LEN_REG(dev) + 0x08)               // Register pages (queues) of the device
+#define extRegBlockSize 0x40
+#define minPageSize     0x1000
+
+/* Each queue occupies the smallest power of 2 page, at least 4KB, holding its registers */
+#define QUEUE_STRIDE(dev) max_t(resource_size_t, roundup_pow_of_two(LEN_REG(dev) + extRegBlockSize), minPageSize)
+
+/* Userspace Interface --------------------------------------------------------------- */
+
+/* Same layout as the entries of the virtio driver's VIRTIO_SHA256_IOC_DIGEST */
+struct sha256_batch_entry {
+    __u64 data;                             // User pointer to the message
+    __u64 len;                              // Message length in bytes
+    __u64 digest;                           // User pointer to 32 bytes for the digest
+    __s32 status;                           // 0 or a negative errno, filled in by the driver
+    __u32 pad;
+};
+
+struct sha256_batch {
+    __u64 entries;                          // User pointer to an array of sha256_batch_entry
+    __u32 count;
+    __u32 pad;
+};
 
 /* Driver Meta Information ----------------------------------------------------------- */
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("SHAHABUDDIN DANISH, AREEB AHMED");
 MODULE_DESCRIPTION("Custom SHA256 Accelerator Core LKM");
-MODULE_VERSION("1.1");
+MODULE_VERSION("1.2");
 
 /* Function Prototypes --------------------------------------------------------------- */
 
 static int sha256_open(struct inode *inode, struct file *file);
 static int sha256_release(struct inode *inode, struct file *file);
 static ssize_t sha256_read(struct file *filep, char __user *buf, size_t count, loff_t *ppos);
-static ssize_t sha256_write(struct file *filep, const char __user *buf, size_t count, loff_t *ppos);
+static ssize_t sha256_write_iter(struct kiocb *iocb, struct iov_iter *from);
 static long sha256_ioctl(struct file *filep, unsigned int cmd, unsigned long arg);
 
 static int major = 0;                       // dynamically allocated
-static struct cdev sha256_cdev;
 static struct class *sha256_class = NULL;
+static DEFINE_IDA(sha256_minors);
+static struct dentry *sha256_debugfs_root;  // /sys/kernel/debug/sha256
+static struct workqueue_struct *sha256_wq;  // Runs the request pipeline of every queue
+
+static unsigned int cache_entries = 0;
+module_param(cache_entries, uint, 0444);
+MODULE_PARM_DESC(cache_entries, "Digests cached per device for messages of up to 256 bytes, 0 disables the cache (default)");
+
+static bool cache_enable = true;
+module_param(cache_enable, bool, 0644);
+MODULE_PARM_DESC(cache_enable, "Answer repeated messages from the digest cache, can be switched at runtime");
+
+static bool calibrate = true;
+module_param(calibrate, bool, 0444);
+MODULE_PARM_DESC(calibrate, "Time the device against software at probe and hash short messages in software "
+                 "where it wins (default), otherwise every message goes to the device");
+
+static unsigned int small_bytes = 4096;
+module_param(small_bytes, uint, 0644);
+MODULE_PARM_DESC(small_bytes, "Complete messages up to this size are scheduled ahead of bulk streams, 0 disables the class");
+
+static int poll_window_ns = 0;
+module_param(poll_window_ns, int, 0644);
+MODULE_PARM_DESC(poll_window_ns, "Completion wait: -1 spin on STATUS_REG until done, 0 spin for a window "
+                 "learned from recent job latencies before sleeping (default), >0 fixed spin window in ns");
+
+/* Per-device statistics, updated locklessly on the hot path and exposed through debugfs */
+enum sha256_phase {
+    PHASE_WRITE,                            // write(2) and splice, including waits for a free bank
+    PHASE_START,                            // SHA256_IOC_START_HASH, launch of the last part up to the digest
+    PHASE_READ,                             // sha256_read of the digest
+    PHASE_BATCH,                            // SHA256_IOC_HASH_BATCH, the whole array
+    NR_PHASES
+};
 
-struct sha256_dev {
+static const char * const sha256_phase_names[NR_PHASES] = { "write", "start", "read", "batch" };
+
+/* Scheduling classes of the request pipeline, see sha256_next_req() */
+enum sha256_class {
+    CLASS_SMALL,                            // Complete messages of up to small_bytes
+    CLASS_BULK,                             // Everything else, weighted by bytes across files
+    NR_CLASSES
+};
+
+static const char * const sha256_class_names[NR_CLASSES] = { "small", "bulk" };
+
+struct sha256_stats {
+    atomic64_t latency[NR_PHASES][latencyBuckets];
+    atomic64_t calls[NR_PHASES];
+    atomic64_t total_ns[NR_PHASES];
+    atomic64_t depth[depthBuckets];
+    atomic64_t bytes;                       // Message bytes accepted by write, splice and batches
+    atomic64_t digests;                     // Successful SHA256_IOC_START_HASH calls and batch entries
+    atomic64_t poll_hits;                   // Bank waits that completed within the spin window
+    atomic64_t poll_sleeps;                 // Bank waits that had to sleep
+    atomic64_t cache_hits;                  // Messages answered from the digest cache
+    atomic64_t cache_misses;                // Cacheable messages that went to the device
+    atomic64_t soft_digests;                // Messages below the crossover hashed in software
+    atomic64_t queue_latency[NR_CLASSES][latencyBuckets];   // Submission to dispatch by the worker
+    atomic64_t queued[NR_CLASSES];
+    atomic64_t queue_ns[NR_CLASSES];
+};
+
+/* Message sizes timed at probe, see sha256_calibrate() */
+static const u32 sha256_cal_sizes[] = { 64, 256, 1024, 4096, 16384, 65536 };
+#define calibrationSizes    ARRAY_SIZE(sha256_cal_sizes)
+
+/* Digest cache entry, keyed on the exact message bytes */
+struct sha256_cache_entry {
+    struct hlist_node hnode;                // Bucket chain, walked under RCU
+    struct list_head lru;                   // Eviction order, under the cache lock
+    struct rcu_head rcu;
+    u32 hash;
+    u32 len;
+    bool referenced;                        // Hit since the eviction hand last passed
+    u8 digest[outputBufferSize];
+    u8 key[];
+};
+
+/* Size-bounded cache, lookups are lock-free and eviction is a CLOCK approximation of LRU */
+struct sha256_cache {
+    spinlock_t lock;                        // Serializes inserts and evictions
+    struct hlist_head *buckets;
+    u32 mask;
+    u32 count;
+    u32 capacity;                           // 0 when the cache is disabled
+    struct list_head lru;                   // Newest first
+};
+
+struct sha256_dev;
+struct sha256_ctx;
+
+/* One input window worth of message staged in kernel memory */
+struct sha256_chunk {
+    struct list_head node;
+    u32 len;
+    u8 data[];
+};
+
+enum sha256_req_kind {
+    REQ_PART,                               // Non-final parts, the queue stays owned by the file
+    REQ_FINAL,                              // Last part, completed with the digest
+    REQ_ABORT,                              // Drop the open message and reset the queue
+    REQ_BATCH,                              // SHA256_IOC_HASH_BATCH entry, only used in traces
+};
+
+/* A request of the queue pipeline, lives on the stack of the waiting submitter or in its batch */
+struct sha256_req {
+    struct list_head node;                  // On the small list of the queue or the list of its file
+    struct sha256_ctx *ctx;
+    enum sha256_req_kind kind;
+    enum sha256_class class;
+    u32 bytes;                              // Message bytes carried, charged to the file when dispatched
+    u64 queued;                             // ktime of the submission
+    struct list_head chunks;                // sha256_chunk, loaded in order
+    int status;
+    struct completion done;
+    u8 digest[outputBufferSize];            // Result of a final part
+};
+
+/* One register page of the device, the sysbus model has one and the PCI model one per queue */
+struct sha256_queue {
+    struct sha256_dev *sdev;
     void __iomem *regs;
+    u32 input_size;                         // Input window size discovered at probe time
+    struct mutex lock;                      // Serializes users of the banks below
+    int fill_bank;                          // Bank mapped into the input window
+    u32 fill_len;                           // Bytes of the current message part loaded into fill_bank
+    bool open;                              // A message has been written but not finalized
+    int irq;                                // Completion vector, 0 when STATUS_REG is polled
+    wait_queue_head_t wait;                 // Woken by the completion vector
+    u64 started[2];                         // ktime of the launch of each bank, 0 when not timed
+    u64 job_ns;                             // Average job latency, drives the adaptive spin window
+    atomic_t inflight;                      // Operations currently inside the driver on this queue
+
+    /* Request pipeline, see sha256_queue_work() */
+    spinlock_t req_lock;                    // Protects the lists below and the deficits of the files
+    struct list_head small;                 // CLASS_SMALL requests in arrival order
+    struct list_head flows;                 // Files with bulk requests, in round robin order
+    int small_run;                          // Small requests served since the last bulk one
+    struct work_struct work;
+    struct sha256_ctx *owner;               // File whose message is open on the device, set by the worker
+    struct sha256_req *pending;             // Request whose final part is being hashed, worker only
+    int pending_bank;
+};
+
+/* Lives until the last open file is gone, the cdev holds a reference on node */
+struct sha256_dev {
     struct device *dev;
+    struct device node;                     // /dev/sha256<n>, its release frees this structure
+    struct cdev cdev;
+    int minor;
+    struct rw_semaphore remove_lock;        // Held for read by file operations, for write by unbind
+    bool dead;                              // Unbound, the registers are gone
+    int nr_queues;
+    struct sha256_queue *queues;
+    struct sha256_stats stats;
+    struct sha256_cache cache;
+    struct dentry *debugfs;
+    u32 crossover;                          // Complete messages shorter than this are hashed in software
+    u64 cal_device_ns[calibrationSizes];    // Probe time calibration, 0 when it was skipped
+    u64 cal_soft_ns[calibrationSizes];
+};
+
+/* Per open file state, the message is staged here outside of any device lock */
+struct sha256_ctx {
+    struct sha256_queue *q;
+    struct mutex lock;                      // Serializes the calls made on this file
+    struct list_head chunks;                // Staged, not yet submitted
+    size_t staged;                          // Bytes in chunks
+    bool open;                              // Non-final parts were submitted, the queue is ours
+    bool done;                              // digest holds the result of the last message
+    bool cache;                             // Use the digest cache, see SHA256_IOC_SET_CACHE
+    bool fallback;                          // Hash below the crossover in software, see SHA256_IOC_SET_FALLBACK
+    u8 digest[outputBufferSize];
+
+    /* Deficit round robin state, under q->req_lock */
+    struct list_head flow;                  // On q->flows while reqs is not empty
+    struct list_head reqs;                  // Bulk requests of this file
+    s64 deficit;                            // Bytes this file may still send before the others' turn
+    u32 weight;                             // Share of the device, see SHA256_IOC_SET_WEIGHT
 };
 
-static struct sha256_dev sha256_device;
+/* The tracepoints read the structures above, see sha256_trace.h */
+#define CREATE_TRACE_POINTS
+#include "sha256_trace.h"
 
 static const struct file_operations sha256_fops = {
     .owner = THIS_MODULE,
     .open = sha256_open,
     .release = sha256_release,
     .read = sha256_read,
-    .write = sha256_write,
+    .write_iter = sha256_write_iter,
+    .splice_write = iter_file_splice_write,     // sendfile(2) and splice(2) from files and pipes
     .unlocked_ioctl = sha256_ioctl,
     .compat_ioctl = sha256_ioctl
 };
 
+static int sha256_submit(struct sha256_ctx *ctx, enum sha256_req_kind kind);
+static int sha256_finalize(struct sha256_ctx *ctx);
+static void sha256_free_chunks(struct list_head *chunks);
+
+/* Bytes a file of weight 1 may send per round, one part of a streamed message */
+static inline s64 sha256_quantum(struct sha256_queue *dev) {
+    return (s64)dev->input_size * stageWindows;
+}
+
+/* Keeps the device bound for the duration of a file operation, fails once it is unbound */
+static int sha256_enter(struct sha256_dev *sdev) {
+
+    down_read(&sdev->remove_lock);
+    if (sdev->dead) {
+        up_read(&sdev->remove_lock);
+        return -ENODEV;
+    }
+    return 0;
+}
+
+static void sha256_leave(struct sha256_dev *sdev) {
+    up_read(&sdev->remove_lock);
+}
+
 static int sha256_open(struct inode *inode, struct file *file) {
     
-    file->private_data = &sha256_device;
-    printk(KERN_INFO "SHA256: Device file opened.\n");
+    struct sha256_dev *sdev = container_of(inode->i_cdev, struct sha256_dev, cdev);
+    struct sha256_ctx *ctx;
+
+    if (READ_ONCE(sdev->dead))
+        return -ENODEV;
+    ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+    if (!ctx)
+        return -ENOMEM;
+
+    // A message spans several calls, so each open file stays on the queue of the opening CPU
+    ctx->q = &sdev->queues[raw_smp_processor_id() % sdev->nr_queues];
+    mutex_init(&ctx->lock);
+    INIT_LIST_HEAD(&ctx->chunks);
+    ctx->cache = true;
+    ctx->fallback = true;
+    INIT_LIST_HEAD(&ctx->flow);
+    INIT_LIST_HEAD(&ctx->reqs);
+    ctx->weight = 1;
+    ctx->deficit = sha256_quantum(ctx->q);
+    file->private_data = ctx;
     return 0;
 }
 
 static int sha256_release(struct inode *inode, struct file *file) {
     
-    // Perform clean-up tasks, such as freeing allocated memory
-    // or shutting down hardware if no longer needed.
+    struct sha256_ctx *ctx = file->private_data;
+    struct sha256_dev *sdev = ctx->q->sdev;
+
+    // A message left open would keep the queue from serving other files
+    sha256_free_chunks(&ctx->chunks);
+    if (ctx->open && !sha256_enter(sdev)) {
+        sha256_submit(ctx, REQ_ABORT);
+        sha256_leave(sdev);
+    }
+    kfree(ctx);
+    return 0;
+}
+
+/* Statistics ------------------------------------------------------------------------ */
+
+/* Enters a timed phase on a queue, records the queue depth and returns the start time */
+static u64 sha256_stat_begin(struct sha256_queue *dev) {
+
+    int depth = atomic_inc_return(&dev->inflight);
+
+    atomic64_inc(&dev->sdev->stats.depth[min(depth, depthBuckets - 1)]);
+    return ktime_get_ns();
+}
+
+static void sha256_stat_end(struct sha256_queue *dev, enum sha256_phase phase, u64 start) {
+
+    struct sha256_stats *st = &dev->sdev->stats;
+    u64 ns = ktime_get_ns() - start;
+    int bucket = ns ? min_t(int, ilog2(ns), latencyBuckets - 1) : 0;
+
+    atomic64_inc(&st->latency[phase][bucket]);
+    atomic64_inc(&st->calls[phase]);
+    atomic64_add(ns, &st->total_ns[phase]);
+    atomic_dec(&dev->inflight);
+}
+
+/* Non-empty latency buckets, one column per phase, for p50/p99 estimates */
+static int sha256_latency_show(struct seq_file *m, void *v) {
+
+    struct sha256_stats *st = m->private;
+
+    seq_printf(m, "%12s", ">=ns");
+    for (int p = 0; p < NR_PHASES; p++)
+        seq_printf(m, " %12s", sha256_phase_names[p]);
+    seq_putc(m, '\n');
+
+    for (int b = 0; b < latencyBuckets; b++) {
+        bool used = false;
+
+        for (int p = 0; p < NR_PHASES; p++)
+            used |= atomic64_read(&st->latency[p][b]) != 0;
+        if (!used)
+            continue;
+
+        seq_printf(m, "%12llu", b ? 1ULL << b : 0ULL);
+        for (int p = 0; p < NR_PHASES; p++)
+            seq_printf(m, " %12lld", atomic64_read(&st->latency[p][b]));
+        seq_putc(m, '\n');
+    }
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(sha256_latency);
+
+/* Queueing latency of the request pipeline, one column per scheduling class */
+static int sha256_queueing_show(struct seq_file *m, void *v) {
+
+    struct sha256_stats *st = m->private;
 
-    printk(KERN_INFO "SHA256: Device file closed.\n");
+    seq_printf(m, "%12s", ">=ns");
+    for (int c = 0; c < NR_CLASSES; c++)
+        seq_printf(m, " %12s", sha256_class_names[c]);
+    seq_putc(m, '\n');
+
+    for (int b = 0; b < latencyBuckets; b++) {
+        bool used = false;
+
+        for (int c = 0; c < NR_CLASSES; c++)
+            used |= atomic64_read(&st->queue_latency[c][b]) != 0;
+        if (!used)
+            continue;
+
+        seq_printf(m, "%12llu", b ? 1ULL << b : 0ULL);
+        for (int c = 0; c < NR_CLASSES; c++)
+            seq_printf(m, " %12lld", atomic64_read(&st->queue_latency[c][b]));
+        seq_putc(m, '\n');
+    }
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(sha256_queueing);
+
+static int sha256_counters_show(struct seq_file *m, void *v) {
+
+    struct sha256_stats *st = m->private;
+    struct sha256_dev *sdev = container_of(st, struct sha256_dev, stats);
+
+    for (int p = 0; p < NR_PHASES; p++) {
+        s64 calls = atomic64_read(&st->calls[p]);
+
+        seq_printf(m, "%s_calls %lld\n", sha256_phase_names[p], calls);
+        seq_printf(m, "%s_avg_ns %lld\n", sha256_phase_names[p],
+                   calls ? div64_s64(atomic64_read(&st->total_ns[p]), calls) : 0);
+    }
+    seq_printf(m, "bytes %lld\n", atomic64_read(&st->bytes));
+    seq_printf(m, "digests %lld\n", atomic64_read(&st->digests));
+    seq_printf(m, "poll_hits %lld\n", atomic64_read(&st->poll_hits));
+    seq_printf(m, "poll_sleeps %lld\n", atomic64_read(&st->poll_sleeps));
+    seq_printf(m, "cache_hits %lld\n", atomic64_read(&st->cache_hits));
+    seq_printf(m, "cache_misses %lld\n", atomic64_read(&st->cache_misses));
+    seq_printf(m, "cache_entries %u\n", READ_ONCE(sdev->cache.count));
+    seq_printf(m, "soft_digests %lld\n", atomic64_read(&st->soft_digests));
+    for (int c = 0; c < NR_CLASSES; c++) {
+        s64 queued = atomic64_read(&st->queued[c]);
+
+        seq_printf(m, "%s_queued %lld\n", sha256_class_names[c], queued);
+        seq_printf(m, "%s_queue_avg_ns %lld\n", sha256_class_names[c],
+                   queued ? div64_s64(atomic64_read(&st->queue_ns[c]), queued) : 0);
+    }
+
+    seq_puts(m, "depth");
+    for (int d = 0; d < depthBuckets; d++)
+        seq_printf(m, " %lld", atomic64_read(&st->depth[d]));
+    seq_putc(m, '\n');
+
+    seq_puts(m, "job_avg_ns");
+    for (int q = 0; q < sdev->nr_queues; q++)
+        seq_printf(m, " %llu", READ_ONCE(sdev->queues[q].job_ns));
+    seq_putc(m, '\n');
     return 0;
 }
+DEFINE_SHOW_ATTRIBUTE(sha256_counters);
+
+/* Any write to the reset file clears the histograms and counters */
+static ssize_t sha256_stats_reset(struct file *file, const char __user *buf, size_t count, loff_t *ppos) {
+
+    struct sha256_stats *st = file->private_data;
+
+    for (int p = 0; p < NR_PHASES; p++) {
+        for (int b = 0; b < latencyBuckets; b++)
+            atomic64_set(&st->latency[p][b], 0);
+        atomic64_set(&st->calls[p], 0);
+        atomic64_set(&st->total_ns[p], 0);
+    }
+    for (int c = 0; c < NR_CLASSES; c++) {
+        for (int b = 0; b < latencyBuckets; b++)
+            atomic64_set(&st->queue_latency[c][b], 0);
+        atomic64_set(&st->queued[c], 0);
+        atomic64_set(&st->queue_ns[c], 0);
+    }
+    for (int d = 0; d < depthBuckets; d++)
+        atomic64_set(&st->depth[d], 0);
+    atomic64_set(&st->bytes, 0);
+    atomic64_set(&st->digests, 0);
+    atomic64_set(&st->poll_hits, 0);
+    atomic64_set(&st->poll_sleeps, 0);
+    atomic64_set(&st->cache_hits, 0);
+    atomic64_set(&st->cache_misses, 0);
+    atomic64_set(&st->soft_digests, 0);
+
+    return count;
+}
+
+static const struct file_operations sha256_reset_fops = {
+    .owner = THIS_MODULE,
+    .open = simple_open,
+    .write = sha256_stats_reset,
+    .llseek = noop_llseek,
+};
+
+static void sha256_debugfs_init(struct sha256_dev *sdev) {
+
+    char name[16];
+
+    snprintf(name, sizeof(name), "sha256%d", sdev->minor);
+    sdev->debugfs = debugfs_create_dir(name, sha256_debugfs_root);
+    debugfs_create_file("latency", 0444, sdev->debugfs, &sdev->stats, &sha256_latency_fops);
+    debugfs_create_file("counters", 0444, sdev->debugfs, &sdev->stats, &sha256_counters_fops);
+    debugfs_create_file("queueing", 0444, sdev->debugfs, &sdev->stats, &sha256_queueing_fops);
+    debugfs_create_file("reset", 0200, sdev->debugfs, &sdev->stats, &sha256_reset_fops);
+}
+
+/* Spin window of the next wait on a queue, following the poll_window_ns policy */
+static u64 sha256_spin_window(struct sha256_queue *dev) {
+
+    int policy = READ_ONCE(poll_window_ns);
+
+    if (policy < 0)
+        return (u64)jobTimeoutUs * NSEC_PER_USEC;
+    if (policy > 0)
+        return policy;
+
+    // Without history spin for the longest window, the first completions teach the average
+    if (!dev->job_ns)
+        return maxSpinNs;
+
+    // Jobs that usually finish soon are caught without a context switch, long ones sleep at once
+    return dev->job_ns > maxSpinNs ? 0 : 2 * dev->job_ns;
+}
+
+/**
+ * @brief Waits until the device has finished with a bank. STATUS_REG is spun on for the
+ * spin window, counted from the launch of the bank, before the wait sleeps on the
+ * completion vector or, without one, polls at pollSleepUs. Called with dev->lock held.
+ *
+ * @return returns 0 or -ETIMEDOUT if the job never completed.
+ */
+
+static int sha256_wait_bank(struct sha256_queue *dev, int bank) {
+
+    struct sha256_stats *st = &dev->sdev->stats;
+    u64 begin = dev->started[bank] ? dev->started[bank] : ktime_get_ns();
+    u64 window = sha256_spin_window(dev);
+    u32 status;
+    bool slept = false;
+    int rc = 0;
+
+    while (ioread32(dev->regs + STATUS_REG) & statusBUSY(bank)) {
+        if (ktime_get_ns() - begin >= window)
+            break;
+        cpu_relax();
+        cond_resched();
+    }
+
+    if (!(ioread32(dev->regs + STATUS_REG) & statusBUSY(bank))) {
+        atomic64_inc(&st->poll_hits);
+    } else {
+        atomic64_inc(&st->poll_sleeps);
+        slept = true;
+        if (dev->irq) {
+            if (!wait_event_timeout(dev->wait, !(ioread32(dev->regs + STATUS_REG) & statusBUSY(bank)),
+                                    usecs_to_jiffies(jobTimeoutUs)))
+                rc = -ETIMEDOUT;
+        } else {
+            rc = readl_poll_timeout(dev->regs + STATUS_REG, status, !(status & statusBUSY(bank)),
+                                    pollSleepUs, jobTimeoutUs);
+        }
+    }
+
+    // Learn from jobs this queue launched, waits on idle banks carry no latency
+    if (dev->started[bank]) {
+        u64 ns = ktime_get_ns() - dev->started[bank];
+
+        if (!rc)
+            WRITE_ONCE(dev->job_ns, dev->job_ns ? dev->job_ns - (dev->job_ns >> latencyShift) + (ns >> latencyShift) : ns);
+        trace_sha256_complete(dev, bank, ns, slept, rc);
+    }
+    dev->started[bank] = 0;
+    return rc;
+}
+
+static irqreturn_t sha256_queue_irq(int irq, void *data) {
+
+    struct sha256_queue *dev = data;
+
+    // MSI-X is edge triggered, there is nothing to acknowledge on the device
+    wake_up(&dev->wait);
+    return IRQ_HANDLED;
+}
+
+/**
+ * @brief Hands the filled bank to the device and switches the input window to the other
+ * bank, so the next part can be loaded while this one is hashed. Called with dev->lock held.
+ *
+ * @param dev Device whose fill bank is started.
+ * @param more True when further parts of the message follow.
+ *
+ * @return returns 0 once the new fill bank is free, or -ETIMEDOUT.
+ */
+
+static int sha256_launch_bank(struct sha256_queue *dev, bool more) {
+
+    u32 ctrl = deviceEN | (dev->fill_bank ? deviceBANK : 0) | (more ? deviceMORE : 0);
+
+    iowrite32(dev->fill_len, dev->regs + LEN_REG(dev));
+    dev->started[dev->fill_bank] = ktime_get_ns();
+    iowrite32(ctrl, dev->regs + CTRL_REG);
+    trace_sha256_start(dev, dev->fill_bank, dev->fill_len, more);
+
+    dev->fill_bank ^= 1;
+    dev->fill_len = 0;
+    dev->open = more;
+    iowrite32(deviceSELECT | (dev->fill_bank ? deviceBANK : 0), dev->regs + CTRL_REG);
+
+    return sha256_wait_bank(dev, dev->fill_bank);
+}
 
 /**
- * @brief This function reads the final SHA256 digest from the hardware device's output 
- * register and transfers it to a userspace buffer. It allows a single read operation 
+ * @brief This function reads the final SHA256 digest of the last message of this file,
+ * collected from the output register by the queue worker, and transfers it to a
+ * userspace buffer. It allows a single read operation 
  * per open instance which is suited for our device where input data must be explicitly 
  * refreshed or reacquired for every consecutive computation.
  * 
@@ -113,29 +689,58 @@ static int sha256_release(struct inode *inode, struct file *file) {
 
 static ssize_t sha256_read(struct file *filep, char __user *buf, size_t count, loff_t *ppos) {
     
-    struct sha256_dev *dev = filep->private_data;
-    uint8_t output_buf;                 // Single byte kernel buffer for output digest
+    struct sha256_ctx *ctx = filep->private_data;
+    struct sha256_queue *dev = ctx->q;
+    u64 start;
+
+    if (sha256_enter(dev->sdev))
+        return -ENODEV;
+    start = sha256_stat_begin(dev);
     
     // Reset the position pointer to zero to start reading from the beginning
     *ppos = 0;
 
+    if (mutex_lock_interruptible(&ctx->lock)) {
+        sha256_stat_end(dev, PHASE_READ, start);
+        sha256_leave(dev->sdev);
+        return -ERESTARTSYS;
+    }
+
+    // Data that arrived through write or splice without SHA256_IOC_START_HASH is finalized here
+    if (ctx->staged || ctx->open) {
+        int rc = sha256_finalize(ctx);
+
+        if (rc) {
+            mutex_unlock(&ctx->lock);
+            sha256_stat_end(dev, PHASE_READ, start);
+            sha256_leave(dev->sdev);
+            return rc;
+        }
+    }
+
+    // Nothing was hashed through this file, report the output register as it stands
+    if (!ctx->done) {
+        mutex_lock(&dev->lock);
+        memcpy_fromio(ctx->digest, dev->regs + OUTPUT_REG(dev), outputBufferSize);
+        mutex_unlock(&dev->lock);
+    }
+
     // Ensure the read request is within the bounds of the output buffer
     if (count > outputBufferSize) {
         count = outputBufferSize;
     }
 
-    // Read each byte individually
-    for (size_t i = 0; i < count; i++) {
-        output_buf = ioread8(dev->regs + OUTPUT_REG + *ppos + i);
-
-        // Debug: Print the byte being read
-        // printk(KERN_INFO "SHA256 Driver: Reading from output register: 0x%02x at virtual address: 0x%08llx\n", output_buf, (unsigned long long)(dev->regs + OUTPUT_REG + *ppos + i));
-
-        // Copy the byte to the userspace buffer
-        if (copy_to_user(buf + i, &output_buf, 1)) {
-            return -EFAULT;  // Return error if copy to userspace fails
-        }
+    // Copy the digest to the userspace buffer
+    if (copy_to_user(buf, ctx->digest, count)) {
+        mutex_unlock(&ctx->lock);
+        sha256_stat_end(dev, PHASE_READ, start);
+        sha256_leave(dev->sdev);
+        return -EFAULT;  // Return error if copy to userspace fails
     }
+    trace_sha256_copyout(dev, ctx, count);
+    mutex_unlock(&ctx->lock);
+    sha256_stat_end(dev, PHASE_READ, start);
+    sha256_leave(dev->sdev);
 
     /* Update the position pointer */
     *ppos += count;
@@ -146,54 +751,748 @@ static ssize_t sha256_read(struct file *filep, char __user *buf, size_t count, l
 }
 
 /**
- * @brief Writes data from userspace to the SHA256 device's input register for hashing. It
- * also initiates the hashing process by writing to the control register. This automatic
- * computation approach is chosen to simplify userspace logic and because there is no extra
- * device configuration to be performed after writing the input buffer. 
+ * @brief Appends data staged in kernel memory to the current message, starting full banks
+ * as non-final parts. Called with dev->lock held.
+ *
+ * @param rc Set to the error that stopped the load, left untouched otherwise.
+ *
+ * @return returns the number of bytes loaded.
+ */
+
+static size_t sha256_load(struct sha256_queue *dev, const u8 *data, size_t len, int *rc) {
+
+    size_t done = 0;
+
+    while (done < len) {
+        size_t chunk;
+
+        // The fill bank is full and the message goes on, hash it while loading the other bank
+        if (dev->fill_len == dev->input_size) {
+            *rc = sha256_launch_bank(dev, true);
+            if (*rc)
+                break;
+        }
+
+        // Write the chunk to the device's input window
+        chunk = min_t(size_t, len - done, dev->input_size - dev->fill_len);
+        memcpy_toio(dev->regs + INPUT_REG + dev->fill_len, data + done, chunk);
+        dev->fill_len += chunk;
+        dev->open = true;
+        done += chunk;
+    }
+
+    return done;
+}
+
+/* Drops the message in progress and returns the queue to bank 0, called with dev->lock held */
+static void sha256_queue_reset(struct sha256_queue *dev) {
+    iowrite32(0, dev->regs + CTRL_REG);         // change this 0 to a fixed macro to make it generic (for future)
+    dev->fill_bank = 0;
+    dev->fill_len = 0;
+    dev->open = false;
+    dev->started[0] = dev->started[1] = 0;
+}
+
+/* Digest Cache ---------------------------------------------------------------------- */
+
+static int sha256_cache_init(struct sha256_cache *cache) {
+
+    spin_lock_init(&cache->lock);
+    INIT_LIST_HEAD(&cache->lru);
+    cache->count = 0;
+    cache->capacity = 0;
+    if (!cache_entries)
+        return 0;
+
+    cache->buckets = kcalloc(roundup_pow_of_two(cache_entries), sizeof(*cache->buckets), GFP_KERNEL);
+    if (!cache->buckets)
+        return -ENOMEM;
+    cache->mask = roundup_pow_of_two(cache_entries) - 1;
+    cache->capacity = cache_entries;
+    return 0;
+}
+
+/* Copies the cached digest of the message, returns false on a miss. Takes no lock */
+static bool sha256_cache_lookup(struct sha256_cache *cache, const u8 *key, u32 len, u32 hash, u8 *digest) {
+
+    struct sha256_cache_entry *e;
+
+    rcu_read_lock();
+    hlist_for_each_entry_rcu(e, &cache->buckets[hash & cache->mask], hnode) {
+        if (e->hash == hash && e->len == len && !memcmp(e->key, key, len)) {
+            memcpy(digest, e->digest, outputBufferSize);
+            if (!READ_ONCE(e->referenced))
+                WRITE_ONCE(e->referenced, true);
+            rcu_read_unlock();
+            return true;
+        }
+    }
+    rcu_read_unlock();
+    return false;
+}
+
+/* Adds a digest, evicting the oldest entries not hit since the hand last passed them */
+static void sha256_cache_insert(struct sha256_cache *cache, const u8 *key, u32 len, u32 hash, const u8 *digest) {
+
+    struct hlist_head *bucket = &cache->buckets[hash & cache->mask];
+    struct sha256_cache_entry *e, *old;
+
+    e = kmalloc(struct_size(e, key, len), GFP_KERNEL);
+    if (!e)
+        return;
+    e->hash = hash;
+    e->len = len;
+    e->referenced = false;
+    memcpy(e->digest, digest, outputBufferSize);
+    memcpy(e->key, key, len);
+
+    spin_lock(&cache->lock);
+
+    // Another file may have added the same message since the lookup
+    hlist_for_each_entry(old, bucket, hnode) {
+        if (old->hash == hash && old->len == len && !memcmp(old->key, key, len)) {
+            spin_unlock(&cache->lock);
+            kfree(e);
+            return;
+        }
+    }
+
+    while (cache->count >= cache->capacity) {
+        old = list_last_entry(&cache->lru, struct sha256_cache_entry, lru);
+        if (old->referenced) {
+            old->referenced = false;
+            list_move(&old->lru, &cache->lru);
+            continue;
+        }
+        hlist_del_rcu(&old->hnode);
+        list_del(&old->lru);
+        cache->count--;
+        kfree_rcu(old, rcu);
+    }
+
+    hlist_add_head_rcu(&e->hnode, bucket);
+    list_add(&e->lru, &cache->lru);
+    cache->count++;
+    spin_unlock(&cache->lock);
+}
+
+/* Whether a complete message of len bytes of this file goes through the cache */
+static bool sha256_cacheable(struct sha256_ctx *ctx, size_t len) {
+    return ctx->q->sdev->cache.capacity && ctx->cache && READ_ONCE(cache_enable) && len <= cacheMaxKey;
+}
+
+/* Frees every entry, called once no file can reach the device any more */
+static void sha256_cache_destroy(struct sha256_cache *cache) {
+
+    struct sha256_cache_entry *e, *tmp;
+
+    list_for_each_entry_safe(e, tmp, &cache->lru, lru) {
+        hlist_del_rcu(&e->hnode);
+        list_del(&e->lru);
+        kfree_rcu(e, rcu);
+    }
+    cache->count = 0;
+}
+
+/* Request Pipeline ------------------------------------------------------------------ */
+
+static void sha256_free_chunks(struct list_head *chunks) {
+
+    struct sha256_chunk *c, *tmp;
+
+    list_for_each_entry_safe(c, tmp, chunks, node) {
+        list_del(&c->node);
+        kvfree(c);
+    }
+}
+
+static void sha256_req_complete(struct sha256_req *req, int status) {
+    req->status = status;
+    complete(&req->done);
+}
+
+/* Collects the digest of the pending request and completes it, called with dev->lock held */
+static void sha256_req_finish(struct sha256_queue *dev) {
+
+    struct sha256_req *req = dev->pending;
+    int status = sha256_wait_bank(dev, dev->pending_bank);
+
+    if (!status) {
+        memcpy_fromio(req->digest, dev->regs + OUTPUT_REG(dev), outputBufferSize);
+        atomic64_inc(&dev->sdev->stats.digests);
+    }
+    dev->pending = NULL;
+    sha256_req_complete(req, status);
+}
+
+/* Takes the oldest bulk request of a file, the file leaves the round while it has none */
+static struct sha256_req *sha256_flow_pop(struct sha256_ctx *ctx) {
+
+    struct sha256_req *req = list_first_entry(&ctx->reqs, struct sha256_req, node);
+
+    list_del(&req->node);
+    if (list_empty(&ctx->reqs))
+        list_del_init(&ctx->flow);
+    return req;
+}
+
+/**
+ * @brief Deficit round robin by bytes over the files with bulk requests. Requests are
+ * charged when dispatched, as the length of a streamed message is not known up front, so
+ * a deficit goes negative and the file sits out the rounds that pay it back. When every
+ * file is in debt the rounds are advanced in one step, each file earning its weight in
+ * quanta per round, until the first one has credit again. Called with dev->req_lock held.
+ *
+ * @return returns the file to serve next.
+ */
+
+static struct sha256_ctx *sha256_drr_pick(struct sha256_queue *dev) {
+
+    struct sha256_ctx *ctx;
+    s64 rounds = S64_MAX;
+
+    list_for_each_entry(ctx, &dev->flows, flow) {
+        if (ctx->deficit > 0)
+            return ctx;
+        rounds = min(rounds, div64_s64(-ctx->deficit, sha256_quantum(dev) * ctx->weight) + 1);
+    }
+
+    list_for_each_entry(ctx, &dev->flows, flow)
+        ctx->deficit += rounds * sha256_quantum(dev) * ctx->weight;
+
+    list_for_each_entry(ctx, &dev->flows, flow) {
+        if (ctx->deficit > 0)
+            return ctx;
+    }
+    return NULL;                            // Not reached, the smallest debt was paid back
+}
+
+/**
+ * @brief Picks the next request for the worker. While a message is open only its own parts
+ * may follow, as the banks hold its state. Otherwise small complete messages go first, up
+ * to smallBurst in a row while bulk requests wait, and bulk requests are shared between
+ * the files by sha256_drr_pick(). Records the queueing latency of the request's class.
+ *
+ * @return returns the request, or NULL when nothing can be served.
+ */
+
+static struct sha256_req *sha256_next_req(struct sha256_queue *dev) {
+
+    struct sha256_stats *st = &dev->sdev->stats;
+    struct sha256_req *req = NULL;
+    u64 ns;
+
+    spin_lock(&dev->req_lock);
+    if (dev->owner) {
+        if (!list_empty(&dev->owner->reqs))
+            req = sha256_flow_pop(dev->owner);
+    } else if (!list_empty(&dev->small) && (dev->small_run < smallBurst || list_empty(&dev->flows))) {
+        req = list_first_entry(&dev->small, struct sha256_req, node);
+        list_del(&req->node);
+        dev->small_run++;
+    } else if (!list_empty(&dev->flows)) {
+        req = sha256_flow_pop(sha256_drr_pick(dev));
+        dev->small_run = 0;
+    }
+    if (req)
+        req->ctx->deficit -= req->bytes;
+    spin_unlock(&dev->req_lock);
+
+    if (req) {
+        ns = ktime_get_ns() - req->queued;
+        atomic64_inc(&st->queue_latency[req->class][ns ? min_t(int, ilog2(ns), latencyBuckets - 1) : 0]);
+        atomic64_inc(&st->queued[req->class]);
+        atomic64_add(ns, &st->queue_ns[req->class]);
+    }
+    return req;
+}
+
+/**
+ * @brief Loads one request into the banks. A final part is started only after the digest
+ * of the pending request has been collected, as both share the output register, and is
+ * then left hashing while the next request is loaded. Called with dev->lock held.
+ */
+
+static void sha256_req_run(struct sha256_queue *dev, struct sha256_req *req) {
+
+    struct sha256_chunk *c;
+    int status = 0;
+
+    if (req->kind != REQ_ABORT) {
+        list_for_each_entry(c, &req->chunks, node) {
+            sha256_load(dev, c->data, c->len, &status);
+            if (status)
+                break;
+        }
+    }
+
+    if (!status && req->kind == REQ_PART) {
+        WRITE_ONCE(dev->owner, req->ctx);
+        sha256_req_complete(req, 0);
+        return;
+    }
+
+    if (dev->pending)
+        sha256_req_finish(dev);
+    WRITE_ONCE(dev->owner, NULL);
+
+    if (!status && req->kind == REQ_FINAL) {
+        status = sha256_launch_bank(dev, false);
+        if (!status) {
+            dev->pending = req;
+            dev->pending_bank = dev->fill_bank ^ 1;
+            return;
+        }
+    }
+
+    sha256_queue_reset(dev);
+    sha256_req_complete(req, status);
+}
+
+/**
+ * @brief Services the submitted requests of a queue. Files stage their data in kernel
+ * memory in their own context and only the copy into the input window is done here, so
+ * the device hashes request N while request N+1 is loaded into the other bank. Digests
+ * are collected, and their waiters completed, in submission order.
+ */
+
+static void sha256_queue_work(struct work_struct *work) {
+
+    struct sha256_queue *dev = container_of(work, struct sha256_queue, work);
+    struct sha256_req *req;
+
+    mutex_lock(&dev->lock);
+    while ((req = sha256_next_req(dev)) || dev->pending) {
+        if (req)
+            sha256_req_run(dev, req);
+        else
+            sha256_req_finish(dev);
+    }
+    mutex_unlock(&dev->lock);
+}
+
+/* Queues a request by class and file for sha256_next_req() and kicks the worker */
+static void sha256_queue_req(struct sha256_queue *dev, struct sha256_req *req) {
+
+    struct sha256_ctx *ctx = req->ctx;
+
+    req->queued = ktime_get_ns();
+    init_completion(&req->done);
+
+    spin_lock(&dev->req_lock);
+    if (req->class == CLASS_SMALL) {
+        list_add_tail(&req->node, &dev->small);
+    } else {
+        // Credit saved while idle is capped at one round, debt is kept
+        if (list_empty(&ctx->reqs)) {
+            ctx->deficit = min(ctx->deficit, sha256_quantum(dev) * ctx->weight);
+            list_add_tail(&ctx->flow, &dev->flows);
+        }
+        list_add_tail(&req->node, &ctx->reqs);
+    }
+    spin_unlock(&dev->req_lock);
+    queue_work(sha256_wq, &dev->work);
+}
+
+/**
+ * @brief Hands the data staged on a file to the worker of its queue and waits until the
+ * request is processed: non-final parts once they are loaded, final parts once the digest
+ * has been copied to the file. Called with ctx->lock held.
+ *
+ * @return returns 0 or the error of the request.
+ */
+
+static int sha256_submit(struct sha256_ctx *ctx, enum sha256_req_kind kind) {
+
+    struct sha256_queue *dev = ctx->q;
+    struct sha256_req req = { .ctx = ctx, .kind = kind, .bytes = ctx->staged };
+
+    trace_sha256_submit(dev, ctx, kind, ctx->staged);
+    INIT_LIST_HEAD(&req.chunks);
+    list_splice_init(&ctx->chunks, &req.chunks);
+    ctx->staged = 0;
+
+    // A complete short message is never part of a stream, it can overtake the bulk files
+    req.class = kind == REQ_FINAL && !ctx->open && req.bytes <= READ_ONCE(small_bytes) ? CLASS_SMALL : CLASS_BULK;
+    sha256_queue_req(dev, &req);
+
+    // Not interruptible, the request is on this stack, bank waits are bounded by jobTimeoutUs
+    wait_for_completion(&req.done);
+    sha256_free_chunks(&req.chunks);
+    if (!req.status && kind == REQ_FINAL)
+        memcpy(ctx->digest, req.digest, outputBufferSize);
+    return req.status;
+}
+
+/* Whether a complete message of len bytes is hashed in software, see sha256_finalize() */
+static bool sha256_soft_wins(struct sha256_ctx *ctx, size_t len) {
+
+    struct sha256_ctx *owner = READ_ONCE(ctx->q->owner);
+
+    return ctx->fallback && (len < READ_ONCE(ctx->q->sdev->crossover) ||
+                             (len <= READ_ONCE(small_bytes) && owner && owner != ctx));
+}
+
+/**
+ * @brief Finalizes the message of a file. A short message that was staged in one piece
+ * is looked up in the digest cache first and does not reach the device on a hit. A staged
+ * message below the crossover of the device, or a small one while another file streams on
+ * the queue, is hashed in software. Called with ctx->lock held.
+ *
+ * @return returns 0 with the digest in ctx->digest, or an error.
+ */
+
+static int sha256_finalize(struct sha256_ctx *ctx) {
+
+    struct sha256_dev *sdev = ctx->q->sdev;
+    struct sha256_cache *cache = &sdev->cache;
+    bool cacheable = !ctx->open && sha256_cacheable(ctx, ctx->staged);
+    u8 key[cacheMaxKey];
+    u32 len = 0, hash = 0;
+    int rc;
+
+    if (cacheable) {
+        struct sha256_chunk *c;
+
+        list_for_each_entry(c, &ctx->chunks, node) {
+            memcpy(key + len, c->data, c->len);
+            len += c->len;
+        }
+        hash = jhash(key, len, 0);
+
+        if (sha256_cache_lookup(cache, key, len, hash, ctx->digest)) {
+            atomic64_inc(&sdev->stats.cache_hits);
+            sha256_free_chunks(&ctx->chunks);
+            ctx->staged = 0;
+            ctx->done = true;
+            return 0;
+        }
+        atomic64_inc(&sdev->stats.cache_misses);
+    }
+
+    // A complete message the device would hash slower never leaves the file, nor does a
+    // small one that would wait behind the open message of another file
+    if (!ctx->open && sha256_soft_wins(ctx, ctx->staged)) {
+        struct sha256_state st;
+        struct sha256_chunk *c;
+
+        sha256_init(&st);
+        list_for_each_entry(c, &ctx->chunks, node)
+            sha256_update(&st, c->data, c->len);
+        sha256_final(&st, ctx->digest);
+        atomic64_inc(&sdev->stats.soft_digests);
+        sha256_free_chunks(&ctx->chunks);
+        ctx->staged = 0;
+        rc = 0;
+    } else {
+        rc = sha256_submit(ctx, REQ_FINAL);
+    }
+    ctx->open = false;
+    ctx->done = !rc;
+    if (!rc && cacheable)
+        sha256_cache_insert(cache, key, len, hash, ctx->digest);
+    return rc;
+}
+
+/**
+ * @brief Stages data on a file, one input window per chunk, without touching the device.
+ * Once stageWindows windows are staged and more data arrives they are submitted as a
+ * non-final part. Called with ctx->lock held.
+ *
+ * @param rc Set to the error that stopped the copy, left untouched otherwise.
+ *
+ * @return returns the number of bytes staged.
+ */
+
+static size_t sha256_stage(struct sha256_ctx *ctx, struct iov_iter *from, int *rc) {
+
+    struct sha256_queue *dev = ctx->q;
+    size_t done = 0;
+
+    while (iov_iter_count(from)) {
+        struct sha256_chunk *c = list_empty(&ctx->chunks) ? NULL :
+                                 list_last_entry(&ctx->chunks, struct sha256_chunk, node);
+        size_t chunk;
+
+        if (!c || c->len == dev->input_size) {
+            // Enough is staged to keep the device busy, hand it over before staging more
+            if (ctx->staged >= stageWindows * dev->input_size) {
+                *rc = sha256_submit(ctx, REQ_PART);
+                ctx->open = !*rc;
+                if (*rc)
+                    break;
+            }
+
+            c = kvmalloc(struct_size(c, data, dev->input_size), GFP_KERNEL);
+            if (!c) {
+                *rc = -ENOMEM;
+                break;
+            }
+            c->len = 0;
+            list_add_tail(&c->node, &ctx->chunks);
+        }
+
+        chunk = min_t(size_t, iov_iter_count(from), dev->input_size - c->len);
+        if (copy_from_iter(c->data + c->len, chunk, from) != chunk) {
+            *rc = -EFAULT;  // Return error if copy from userspace fails
+            break;
+        }
+        c->len += chunk;
+        ctx->staged += chunk;
+        done += chunk;
+    }
+
+    return done;
+}
+
+/**
+ * @brief Writes data to the SHA256 device for hashing, from write(2) or from
+ * sendfile(2)/splice(2) through iter_file_splice_write. The data is staged in kernel
+ * memory, one input window per chunk, without touching the device. Once stageWindows
+ * windows are staged and more data arrives they are submitted as non-final parts. The
+ * last part is submitted by SHA256_IOC_START_HASH or by the next read.
  * 
- * @param filep Pointer to file object set during open call.
- * @param buf Pointer to the user buffer from which data is written.
- * @param count The number of bytes to write.
- * @param ppos Position pointer, not used for writing in this driver.
+ * @param iocb I/O control block of the file set during open call.
+ * @param from Source of the data, user memory or page-cache pages.
  * 
  * @return returns number of bytes written or an error code.
  */
 
-static ssize_t sha256_write(struct file *filep, const char __user *buf, size_t count, loff_t *ppos) {
+static ssize_t sha256_write_iter(struct kiocb *iocb, struct iov_iter *from) {
     
-    struct sha256_dev *dev = filep->private_data;
-    char input_buf;            // Single byte kernel buffer for input data
+    struct sha256_ctx *ctx = iocb->ki_filp->private_data;
+    struct sha256_queue *dev = ctx->q;
+    size_t done = 0;
+    int rc = 0;
+    u64 start;
+
+    if (sha256_enter(dev->sdev))
+        return -ENODEV;
+    start = sha256_stat_begin(dev);
+
+    if (mutex_lock_interruptible(&ctx->lock)) {
+        sha256_stat_end(dev, PHASE_WRITE, start);
+        sha256_leave(dev->sdev);
+        return -ERESTARTSYS;
+    }
+
+    done = sha256_stage(ctx, from, &rc);
+
+    mutex_unlock(&ctx->lock);
+    atomic64_add(done, &dev->sdev->stats.bytes);
+    sha256_stat_end(dev, PHASE_WRITE, start);
+    sha256_leave(dev->sdev);
+
+    if (done == 0 && rc)
+        return rc;
+
+    // Update the position pointer
+    iocb->ki_pos += done;
+
+    // Return the number of bytes written
+    return done;
+}
+
+/* A small batch entry queued on the pipeline, see sha256_hash_batch() */
+struct sha256_batch_slot {
+    struct sha256_req req;
+    u32 index;                              // Entry of the user array
+    u64 digest;                             // User pointer to the digest of the entry
+    bool cacheable;                         // Missed the digest cache, insert the result
+    u32 hash;
+};
+
+/**
+ * @brief Hands the digest and status of a batch entry back to userspace.
+ *
+ * @return returns -EFAULT if the entry could not be updated, otherwise 0.
+ */
+
+static int sha256_batch_done(struct sha256_ctx *ctx, struct sha256_batch_entry __user *uent,
+                             u64 digest, const u8 *out, s32 status) {
+
+    if (!status) {
+        if (copy_to_user(u64_to_user_ptr(digest), out, outputBufferSize))
+            status = -EFAULT;
+        else
+            trace_sha256_copyout(ctx->q, ctx, outputBufferSize);
+    }
+
+    return put_user(status, &uent->status) ? -EFAULT : 0;
+}
+
+/* Waits for a queued small entry, caches its digest and hands the result back */
+static int sha256_batch_collect(struct sha256_ctx *ctx, struct sha256_batch_entry __user *uent,
+                                struct sha256_batch_slot *slot) {
+
+    struct sha256_chunk *c = list_first_entry(&slot->req.chunks, struct sha256_chunk, node);
+
+    wait_for_completion(&slot->req.done);
+    if (!slot->req.status && slot->cacheable)
+        sha256_cache_insert(&ctx->q->sdev->cache, c->data, c->len, slot->hash, slot->req.digest);
+    sha256_free_chunks(&slot->req.chunks);
+    return sha256_batch_done(ctx, &uent[slot->index], slot->digest, slot->req.digest, slot->req.status);
+}
+
+/**
+ * @brief Hashes an array of independent messages in one call, through the request
+ * pipeline like any other message. Small entries are copied into one chunk each and
+ * queued as CLASS_SMALL requests, up to batchDepth at a time, so the worker loads the
+ * next entry while the device hashes the previous one and the small requests of other
+ * files interleave with them. Longer entries are staged and finalized like a written
+ * message, in bulk parts shared with the other files by sha256_drr_pick(). Short entries
+ * are answered from the digest cache and their results added to it, like a message
+ * finalized on the file. Entries that sha256_soft_wins() are hashed in software. A
+ * failing entry only sets its own status.
+ *
+ * @param ctx Calling file, it must not hold a partially written message.
+ * @param ubatch User pointer to the batch descriptor.
+ *
+ * @return returns 0 once every entry has a status, or an error for the whole call.
+ */
 
-    /* Check if the input size exceeds 1KB
-    if (count > inputBufferSize) {
-        printk(KERN_WARNING "SHA256: Input size exceeds 1KB, rejecting the input.\n");
-        return -EINVAL;  // Return an error code indicating invalid argument
+static long sha256_hash_batch(struct sha256_ctx *ctx, struct sha256_batch __user *ubatch) {
+
+    struct sha256_queue *dev = ctx->q;
+    struct sha256_stats *st = &dev->sdev->stats;
+    struct sha256_cache *cache = &dev->sdev->cache;
+    struct sha256_batch batch;
+    struct sha256_batch_entry __user *uent;
+    struct sha256_batch_slot *slots;
+    u32 head = 0, tail = 0;                 // Queued small entries, the oldest at head
+    long rc = 0;
+    u64 start;
+
+    if (copy_from_user(&batch, ubatch, sizeof(batch)))
+        return -EFAULT;
+    if (batch.count == 0 || batch.count > maxBatchEntries)
+        return -EINVAL;
+    uent = u64_to_user_ptr(batch.entries);
+
+    slots = kcalloc(batchDepth, sizeof(*slots), GFP_KERNEL);
+    if (!slots)
+        return -ENOMEM;
+
+    start = sha256_stat_begin(dev);
+    if (mutex_lock_interruptible(&ctx->lock)) {
+        rc = -ERESTARTSYS;
+        goto out_stat;
     }
-    */
 
-    // Check the amount of data to be written does not exceed the input buffer size
-    if (count > inputBufferSize) {
-        count = inputBufferSize;
+    // The entries would be hashed into the message this file is writing
+    if (ctx->staged || ctx->open) {
+        rc = -EBUSY;
+        goto out;
     }
 
-    // Write each byte individually
-    for (size_t i = 0; i < count; i++) {
-        if (copy_from_user(&input_buf, buf + i, 1)) {
-            return -EFAULT;  // Return error if copy from userspace fails
+    for (u32 i = 0; i < batch.count; i++) {
+        struct sha256_batch_entry e;
+        struct sha256_batch_slot *slot;
+        struct sha256_chunk *c;
+        u8 out[outputBufferSize];
+        struct iov_iter iter;
+        bool cacheable;
+        u32 hash = 0;
+        int status;
+
+        if (copy_from_user(&e, &uent[i], sizeof(e))) {
+            rc = -EFAULT;
+            break;
+        }
+
+        trace_sha256_submit(dev, ctx, REQ_BATCH, e.len);
+        if (e.len > MAX_RW_COUNT)
+            status = -EINVAL;
+        else
+            status = import_ubuf(ITER_SOURCE, u64_to_user_ptr(e.data), e.len, &iter);
+        if (status) {
+            if (put_user(status, &uent[i].status))
+                rc = -EFAULT;
+            continue;
+        }
+
+        // Longer entries are streamed in parts, like a message written to the file
+        if (e.len > READ_ONCE(small_bytes) || e.len > sha256_quantum(dev)) {
+            sha256_stage(ctx, &iter, &status);
+            if (!status) {
+                status = sha256_finalize(ctx);
+            } else {
+                sha256_free_chunks(&ctx->chunks);
+                ctx->staged = 0;
+                if (ctx->open)
+                    sha256_submit(ctx, REQ_ABORT);
+                ctx->open = false;
+            }
+            atomic64_add(status ? 0 : e.len, &st->bytes);
+            if (sha256_batch_done(ctx, &uent[i], e.digest, ctx->digest, status))
+                rc = -EFAULT;
+            continue;
+        }
+
+        c = kvmalloc(struct_size(c, data, e.len), GFP_KERNEL);
+        if (!c)
+            status = -ENOMEM;
+        else if (copy_from_iter(c->data, e.len, &iter) != e.len)
+            status = -EFAULT;
+        if (status) {
+            kvfree(c);
+            if (put_user(status, &uent[i].status))
+                rc = -EFAULT;
+            continue;
+        }
+        c->len = e.len;
+        atomic64_add(e.len, &st->bytes);
+
+        cacheable = sha256_cacheable(ctx, c->len);
+        if (cacheable) {
+            hash = jhash(c->data, c->len, 0);
+            if (sha256_cache_lookup(cache, c->data, c->len, hash, out)) {
+                atomic64_inc(&st->cache_hits);
+                kvfree(c);
+                if (sha256_batch_done(ctx, &uent[i], e.digest, out, 0))
+                    rc = -EFAULT;
+                continue;
+            }
+            atomic64_inc(&st->cache_misses);
         }
 
-        // Debug: Print the byte being written
-        // printk(KERN_INFO "SHA256 Driver: Writing to input register: 0x%02x at virtual address: 0x%08llx\n", input_buf, (unsigned long long)(dev->regs + INPUT_REG + *ppos + i));
+        if (sha256_soft_wins(ctx, e.len)) {
+            sha256(c->data, c->len, out);
+            atomic64_inc(&st->soft_digests);
+            if (cacheable)
+                sha256_cache_insert(cache, c->data, c->len, hash, out);
+            kvfree(c);
+            if (sha256_batch_done(ctx, &uent[i], e.digest, out, 0))
+                rc = -EFAULT;
+            continue;
+        }
 
-        // Write the byte to the device's input register
-        iowrite8(input_buf, dev->regs + INPUT_REG + *ppos + i);
+        // A full window waits for its oldest entry, the requests complete in order
+        if (tail - head == batchDepth && sha256_batch_collect(ctx, uent, &slots[head++ % batchDepth]))
+            rc = -EFAULT;
+
+        slot = &slots[tail++ % batchDepth];
+        slot->index = i;
+        slot->digest = e.digest;
+        slot->cacheable = cacheable;
+        slot->hash = hash;
+        slot->req = (struct sha256_req){ .ctx = ctx, .kind = REQ_FINAL, .class = CLASS_SMALL, .bytes = c->len };
+        INIT_LIST_HEAD(&slot->req.chunks);
+        list_add_tail(&c->node, &slot->req.chunks);
+        sha256_queue_req(dev, &slot->req);
     }
 
-    // Update the position pointer
-    *ppos += count;
+    while (head != tail) {
+        if (sha256_batch_collect(ctx, uent, &slots[head++ % batchDepth]))
+            rc = -EFAULT;
+    }
 
-    // Return the number of bytes written
-    return count;
+out:
+    mutex_unlock(&ctx->lock);
+out_stat:
+    sha256_stat_end(dev, PHASE_BATCH, start);
+    kfree(slots);
+    return rc;
 }
 
 /**
@@ -206,9 +1505,11 @@ static ssize_t sha256_write(struct file *filep, const char __user *buf, size_t c
  * @return returns 0 indicating success of the IOCTL operation or an error.
  */
 
-static long sha256_ioctl(struct file *filep, unsigned int cmd, unsigned long arg) {
+static long sha256_ioctl_cmd(struct file *filep, unsigned int cmd, unsigned long arg) {
 
-    struct sha256_dev *dev = filep->private_data;
+    struct sha256_ctx *ctx = filep->private_data;
+    struct sha256_queue *dev = ctx->q;
+    u64 start;
     int status;
 
     switch (cmd) {
@@ -229,15 +1530,60 @@ static long sha256_ioctl(struct file *filep, unsigned int cmd, unsigned long arg
             break;
 
         case SHA256_IOC_START_HASH:
-            // Write EN to the control register to initiate the hashing process
-            iowrite32(deviceEN, dev->regs + CTRL_REG);
-            printk(KERN_INFO "SHA256: Hashing process started.\n");
+            // Submit the last part of the message and wait for the digest
+            start = sha256_stat_begin(dev);
+            if (mutex_lock_interruptible(&ctx->lock)) {
+                sha256_stat_end(dev, PHASE_START, start);
+                return -ERESTARTSYS;
+            }
+            status = sha256_finalize(ctx);
+            mutex_unlock(&ctx->lock);
+            sha256_stat_end(dev, PHASE_START, start);
+            if (status)
+                return status;
+            break;
+
+        case SHA256_IOC_HASH_BATCH:
+            return sha256_hash_batch(ctx, (struct sha256_batch __user *)arg);
+
+        case SHA256_IOC_SET_CACHE:
+            // Opt this file in or out of the digest cache, arg is the new setting
+            mutex_lock(&ctx->lock);
+            ctx->cache = arg != 0;
+            mutex_unlock(&ctx->lock);
+            break;
+
+        case SHA256_IOC_SET_WEIGHT:
+            // Share of the queue this file gets against other bulk streams, 1 to maxWeight
+            if (arg < 1 || arg > maxWeight)
+                return -EINVAL;
+            spin_lock(&dev->req_lock);
+            ctx->weight = arg;
+            spin_unlock(&dev->req_lock);
+            break;
+
+        case SHA256_IOC_SET_FALLBACK:
+            // Opt this file out of the software fallback, e.g. to time the device itself
+            mutex_lock(&ctx->lock);
+            ctx->fallback = arg != 0;
+            mutex_unlock(&ctx->lock);
+            break;
+
+        case SHA256_IOC_GET_INPUT_SIZE:
+            // Report the input window size so userspace can size its buffers
+            if (copy_to_user((u32 __user *)arg, &dev->input_size, sizeof(dev->input_size)))
+                return -EFAULT;
             break;
 
         case SHA256_IOC_RESET:
-            // Reset the device by writing reset value to the control register
-            iowrite32(0, dev->regs + CTRL_REG);         // change this 0 to a fixed macro to make it generic (for future)
-            printk(KERN_INFO "SHA256: Device reset\n");
+            // Drop the message of this file, the queue is reset once the pipeline reaches it
+            mutex_lock(&ctx->lock);
+            sha256_free_chunks(&ctx->chunks);
+            ctx->staged = 0;
+            sha256_submit(ctx, REQ_ABORT);
+            ctx->open = false;
+            ctx->done = false;
+            mutex_unlock(&ctx->lock);
             break;
 
         default:
@@ -248,6 +1594,352 @@ static long sha256_ioctl(struct file *filep, unsigned int cmd, unsigned long arg
     return 0; // Success
 }
 
+/* Entry point of the file, the device stays bound while the command runs */
+static long sha256_ioctl(struct file *filep, unsigned int cmd, unsigned long arg) {
+
+    struct sha256_dev *sdev = ((struct sha256_ctx *)filep->private_data)->q->sdev;
+    long rc = sha256_enter(sdev);
+
+    if (rc)
+        return rc;
+    rc = sha256_ioctl_cmd(filep, cmd, arg);
+    sha256_leave(sdev);
+    return rc;
+}
+
+/* Self-Test and Calibration --------------------------------------------------------- */
+
+/* Known answers from FIPS 180-2, a longer message spanning both banks is checked against software */
+static const struct {
+    const char *msg;
+    u8 digest[outputBufferSize];
+} sha256_kats[] = {
+    { "", { 0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14, 0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+            0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c, 0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55 } },
+    { "abc", { 0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+               0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad } },
+    { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+      { 0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8, 0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+        0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67, 0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1 } },
+};
+
+/* Hashes a kernel buffer on a queue nobody else uses yet, parts and all */
+static int sha256_device_digest(struct sha256_queue *dev, const void *data, size_t len, u8 *out) {
+
+    int rc = 0;
+
+    mutex_lock(&dev->lock);
+    sha256_load(dev, data, len, &rc);
+    if (!rc)
+        rc = sha256_launch_bank(dev, false);
+    if (!rc)
+        rc = sha256_wait_bank(dev, dev->fill_bank ^ 1);
+    if (!rc)
+        memcpy_fromio(out, dev->regs + OUTPUT_REG(dev), outputBufferSize);
+    else
+        sha256_queue_reset(dev);
+    mutex_unlock(&dev->lock);
+    return rc;
+}
+
+/**
+ * @brief Checks every queue against the known answers and against software for a message
+ * of two and a bit input windows, which takes the non-final part path through both banks.
+ *
+ * @param buf Scratch buffer of at least 2 * input_size + 5 bytes.
+ *
+ * @return returns 0, -EIO on a wrong digest or the error of the device.
+ */
+
+static int sha256_selftest(struct sha256_dev *sdev, u8 *buf) {
+
+    u8 out[outputBufferSize], expect[outputBufferSize];
+    size_t len = 2 * sdev->queues[0].input_size + 5;
+    int rc;
+
+    for (size_t i = 0; i < len; i++)
+        buf[i] = i * 31 + 7;
+    sha256(buf, len, expect);
+
+    for (int q = 0; q < sdev->nr_queues; q++) {
+        struct sha256_queue *dev = &sdev->queues[q];
+
+        for (int k = 0; k < ARRAY_SIZE(sha256_kats); k++) {
+            rc = sha256_device_digest(dev, sha256_kats[k].msg, strlen(sha256_kats[k].msg), out);
+            if (rc)
+                return rc;
+            if (memcmp(out, sha256_kats[k].digest, outputBufferSize)) {
+                dev_err(sdev->dev, "Queue %d: wrong digest for known answer %d\n", q, k);
+                return -EIO;
+            }
+        }
+
+        rc = sha256_device_digest(dev, buf, len, out);
+        if (rc)
+            return rc;
+        if (memcmp(out, expect, outputBufferSize)) {
+            dev_err(sdev->dev, "Queue %d: wrong digest for a %zu byte message\n", q, len);
+            return -EIO;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Times queue 0 against the in-kernel software SHA-256 for every calibration size
+ * and sets the crossover: the smallest size from which the device wins at every larger
+ * size. Complete messages below it are hashed in software, messages streamed in parts
+ * always go to the device.
+ *
+ * @param buf Scratch buffer of at least the largest calibration size.
+ */
+
+static void sha256_calibrate(struct sha256_dev *sdev, u8 *buf) {
+
+    struct sha256_queue *dev = &sdev->queues[0];
+    u8 out[outputBufferSize];
+
+    sdev->crossover = 0;
+    for (int i = 0; i < calibrationSizes; i++) {
+        u32 len = sha256_cal_sizes[i];
+        u64 best_dev = U64_MAX, best_soft = U64_MAX;
+
+        for (int r = 0; r < calibrationRounds; r++) {
+            u64 t = ktime_get_ns();
+
+            if (sha256_device_digest(dev, buf, len, out)) {
+                dev_warn(sdev->dev, "Calibration failed, every message goes to the device\n");
+                memset(sdev->cal_device_ns, 0, sizeof(sdev->cal_device_ns));
+                memset(sdev->cal_soft_ns, 0, sizeof(sdev->cal_soft_ns));
+                sdev->crossover = 0;
+                return;
+            }
+            best_dev = min(best_dev, ktime_get_ns() - t);
+
+            t = ktime_get_ns();
+            sha256(buf, len, out);
+            best_soft = min(best_soft, ktime_get_ns() - t);
+            cond_resched();
+        }
+
+        sdev->cal_device_ns[i] = best_dev;
+        sdev->cal_soft_ns[i] = best_soft;
+        if (best_dev >= best_soft)
+            sdev->crossover = i + 1 < calibrationSizes ? sha256_cal_sizes[i + 1] : U32_MAX;
+    }
+
+    // The job latency learned from the calibration runs is not that of real traffic
+    dev->job_ns = 0;
+}
+
+/* /sys/class/sha256_accel/sha256<n>/calibration: size, device and software time in ns */
+static ssize_t calibration_show(struct device *dev, struct device_attribute *attr, char *buf) {
+
+    struct sha256_dev *sdev = dev_get_drvdata(dev);
+    int len = 0;
+
+    for (int i = 0; i < calibrationSizes; i++)
+        len += sysfs_emit_at(buf, len, "%u %llu %llu\n", sha256_cal_sizes[i],
+                             sdev->cal_device_ns[i], sdev->cal_soft_ns[i]);
+    return len;
+}
+static DEVICE_ATTR_RO(calibration);
+
+/* Messages shorter than this many bytes are hashed in software, writable to override */
+static ssize_t crossover_show(struct device *dev, struct device_attribute *attr, char *buf) {
+
+    struct sha256_dev *sdev = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%u\n", READ_ONCE(sdev->crossover));
+}
+
+static ssize_t crossover_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+
+    struct sha256_dev *sdev = dev_get_drvdata(dev);
+    u32 value;
+    int rc = kstrtou32(buf, 0, &value);
+
+    if (rc)
+        return rc;
+    WRITE_ONCE(sdev->crossover, value);
+    return count;
+}
+static DEVICE_ATTR_RW(crossover);
+
+static struct attribute *sha256_attrs[] = {
+    &dev_attr_calibration.attr,
+    &dev_attr_crossover.attr,
+    NULL,
+};
+ATTRIBUTE_GROUPS(sha256);
+
+/* Runs once the device is unbound and the last open file is closed */
+static void sha256_node_release(struct device *node) {
+
+    struct sha256_dev *sdev = container_of(node, struct sha256_dev, node);
+
+    if (sdev->minor >= 0)
+        ida_free(&sha256_minors, sdev->minor);
+    kfree(sdev->queues);
+    kfree(sdev->cache.buckets);
+    kfree(sdev);
+}
+
+/**
+ * @brief Common part of the platform and PCI probes: discovers the register layout,
+ * sets up every queue, checks the digests of the device and creates the /dev/sha256<n>
+ * node. A device that fails the self-test is not bound.
+ *
+ * @param dev Parent device of the /dev/sha256<n> node.
+ * @param regs Mapped registers, queue 0 at offset 0.
+ * @param len Size of the register resource.
+ * @param of_size Fallback input window size when CAP_REG is missing, 0 for none.
+ *
+ * @return returns the new device or an ERR_PTR.
+ */
+
+static struct sha256_dev *sha256_setup(struct device *dev, void __iomem *regs, resource_size_t len, u32 of_size) {
+
+    struct sha256_dev *sdev;
+    struct sha256_queue probe = { .regs = regs };
+    resource_size_t stride;
+    u32 queues;
+    u8 *buf;
+    int rc;
+
+    // Discover the input window size, older models without CAP_REG read back 0xDEADBEEF
+    probe.input_size = ioread32(regs + CAP_REG);
+    if (probe.input_size == 0 || probe.input_size > maxInputSize)
+        probe.input_size = of_size ? of_size : defaultInputSize;
+
+    if (len < QUEUES_REG(&probe) + sizeof(u32)) {
+        dev_err(dev, "Register window too small for a %u byte input window\n", probe.input_size);
+        return ERR_PTR(-EINVAL);
+    }
+
+    // Models without QUEUES_REG have a single register page
+    queues = ioread32(regs + QUEUES_REG(&probe));
+    stride = QUEUE_STRIDE(&probe);
+    if (queues == 0 || queues > len / stride)
+        queues = 1;
+
+    // Not devm memory, open files keep it past unbind through the reference of the cdev
+    sdev = kzalloc(sizeof(*sdev), GFP_KERNEL);
+    if (!sdev)
+        return ERR_PTR(-ENOMEM);
+    sdev->minor = -1;
+    device_initialize(&sdev->node);
+    sdev->node.release = sha256_node_release;
+    init_rwsem(&sdev->remove_lock);
+
+    sdev->queues = kcalloc(queues, sizeof(*sdev->queues), GFP_KERNEL);
+    if (!sdev->queues) {
+        rc = -ENOMEM;
+        goto err_put;
+    }
+    sdev->dev = dev;
+    sdev->nr_queues = queues;
+    rc = sha256_cache_init(&sdev->cache);
+    if (rc)
+        goto err_put;
+
+    for (int i = 0; i < queues; i++) {
+        struct sha256_queue *q = &sdev->queues[i];
+
+        q->sdev = sdev;
+        q->regs = regs + i * stride;
+        q->input_size = probe.input_size;
+
+        // Start from a known state with bank 0 in the input window
+        mutex_init(&q->lock);
+        init_waitqueue_head(&q->wait);
+        atomic_set(&q->inflight, 0);
+        spin_lock_init(&q->req_lock);
+        INIT_LIST_HEAD(&q->small);
+        INIT_LIST_HEAD(&q->flows);
+        q->small_run = 0;
+        INIT_WORK(&q->work, sha256_queue_work);
+        q->owner = NULL;
+        q->pending = NULL;
+        q->started[0] = q->started[1] = 0;
+        q->job_ns = 0;
+        iowrite32(0, q->regs + CTRL_REG);
+        q->fill_bank = 0;
+        q->fill_len = 0;
+        q->open = false;
+    }
+
+    // Nothing can reach the queues before the node exists, so they are free for the test
+    buf = kvmalloc(max_t(size_t, 2 * probe.input_size + 5, sha256_cal_sizes[calibrationSizes - 1]), GFP_KERNEL);
+    if (!buf) {
+        rc = -ENOMEM;
+        goto err_put;
+    }
+    rc = sha256_selftest(sdev, buf);
+    if (!rc && calibrate)
+        sha256_calibrate(sdev, buf);
+    kvfree(buf);
+    if (rc) {
+        dev_err(dev, "Self-test failed (%d), not binding\n", rc);
+        goto err_put;
+    }
+
+    sdev->minor = ida_alloc_max(&sha256_minors, maxDevices - 1, GFP_KERNEL);
+    if (sdev->minor < 0) {
+        rc = sdev->minor;
+        goto err_put;
+    }
+
+    // Register the device - the cdev pins node, and so sdev, while a file is open
+    sdev->node.class = sha256_class;
+    sdev->node.parent = dev;
+    sdev->node.devt = MKDEV(major, sdev->minor);
+    sdev->node.groups = sha256_groups;
+    dev_set_drvdata(&sdev->node, sdev);
+    rc = dev_set_name(&sdev->node, "sha256%d", sdev->minor);
+    if (rc)
+        goto err_put;
+
+    cdev_init(&sdev->cdev, &sha256_fops);
+    sdev->cdev.owner = THIS_MODULE;
+    rc = cdev_device_add(&sdev->cdev, &sdev->node);
+    if (rc) {
+        dev_err(dev, "Failed to add the device node: %d\n", rc);
+        goto err_put;
+    }
+
+    sha256_debugfs_init(sdev);
+
+    dev_info(dev, "SHA256 device sha256%d: %d queue(s), %u byte input window, software below %u bytes\n",
+             sdev->minor, sdev->nr_queues, probe.input_size, sdev->crossover);
+    return sdev;
+
+err_put:
+    put_device(&sdev->node);
+    return ERR_PTR(rc);
+}
+
+/**
+ * @brief Unbinds the device. File operations in progress are drained and later ones fail
+ * with -ENODEV, as the registers are unmapped once remove returns. The structure itself
+ * is freed by sha256_node_release() when the last open file is closed. The caller drops
+ * its reference with put_device() once it no longer needs the queues.
+ */
+
+static void sha256_teardown(struct sha256_dev *sdev) {
+
+    debugfs_remove_recursive(sdev->debugfs);
+    cdev_device_del(&sdev->cdev, &sdev->node);
+
+    down_write(&sdev->remove_lock);
+    sdev->dead = true;
+    up_write(&sdev->remove_lock);
+
+    for (int i = 0; i < sdev->nr_queues; i++)
+        flush_work(&sdev->queues[i].work);
+    sha256_cache_destroy(&sdev->cache);
+}
+
 /**
  * @brief Probes for the SHA256 device at module initialization.
  * This function is called by the Linux kernel when the platform driver is registered
@@ -262,11 +1954,11 @@ static long sha256_ioctl(struct file *filep, unsigned int cmd, unsigned long arg
 
 static int sha256_probe(struct platform_device *pdev) {
 
-    printk(KERN_INFO "SHA256: Probe function called.\n");
-
     struct resource *res;
     struct device *dev = &pdev->dev;
-    int rc;
+    struct sha256_dev *sdev;
+    void __iomem *regs;
+    u32 of_size = 0;
 
     res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
     if (!res) {
@@ -274,39 +1966,107 @@ static int sha256_probe(struct platform_device *pdev) {
         return -ENODEV;
     }
 
-    sha256_device.regs = devm_ioremap_resource(dev, res);
-    if (IS_ERR(sha256_device.regs)) {
+    regs = devm_ioremap_resource(dev, res);
+    if (IS_ERR(regs)) {
         dev_err(dev, "Cannot map registers\n");
-        return PTR_ERR(sha256_device.regs);
+        return PTR_ERR(regs);
     }
 
-    sha256_device.dev = dev;
+    of_property_read_u32(dev->of_node, "input-size", &of_size);
+
+    // The sysbus model has no interrupt line, its queue is polled
+    sdev = sha256_setup(dev, regs, resource_size(res), of_size);
+    if (IS_ERR(sdev))
+        return PTR_ERR(sdev);
+
+    platform_set_drvdata(pdev, sdev);
+    return 0;
+}
+
+static int sha256_remove(struct platform_device *pdev) {
+
+    struct sha256_dev *sdev = platform_get_drvdata(pdev);
+
+    sha256_teardown(sdev);
+    put_device(&sdev->node);
+    return 0;
+}
 
-    // Register the device - create cdev entry
-    cdev_init(&sha256_cdev, &sha256_fops);
-    sha256_cdev.owner = THIS_MODULE;
-    rc = cdev_add(&sha256_cdev, MKDEV(major, 0), 1);
+/**
+ * @brief Probes the PCI variant. BAR 0 holds one register page per queue and every queue
+ * gets its own MSI-X vector, bound to its own CPU so completions of independent streams are
+ * handled in parallel and close to the submitter. Queues fall back to polling when the
+ * vectors cannot be allocated.
+ *
+ * @param pdev PCI device matched by sha256_pci_ids.
+ * @param id Matching table entry, not used.
+ *
+ * @return Returns 0 on success, negative error codes on failure.
+ */
+
+static int sha256_pci_probe(struct pci_dev *pdev, const struct pci_device_id *id) {
+
+    struct device *dev = &pdev->dev;
+    struct sha256_dev *sdev;
+    int rc, nvec;
+
+    rc = pcim_enable_device(pdev);
+    if (rc)
+        return rc;
+
+    rc = pcim_iomap_regions(pdev, BIT(0), DRIVER_NAME);
     if (rc) {
-        dev_err(dev, "Failed to add cdev\n");
+        dev_err(dev, "Cannot map registers\n");
         return rc;
     }
 
-    // Create class entry
-    struct device *result = device_create(sha256_class, dev, MKDEV(major, 0), NULL, "sha256%d", 0);
-    if (IS_ERR(result)) {
-        printk(KERN_ERR "Failed to create device: %ld\n", PTR_ERR(result));
-    } else {
-        printk(KERN_INFO "SHA256 Device created successfully\n");
+    sdev = sha256_setup(dev, pcim_iomap_table(pdev)[0], pci_resource_len(pdev, 0), 0);
+    if (IS_ERR(sdev))
+        return PTR_ERR(sdev);
+    pci_set_drvdata(pdev, sdev);
+
+    nvec = pci_alloc_irq_vectors(pdev, sdev->nr_queues, sdev->nr_queues, PCI_IRQ_MSIX);
+    if (nvec < 0) {
+        dev_warn(dev, "No MSI-X vectors (%d), polling the queues\n", nvec);
+        return 0;
+    }
+
+    for (int i = 0; i < sdev->nr_queues; i++) {
+        struct sha256_queue *q = &sdev->queues[i];
+        int irq = pci_irq_vector(pdev, i);
+
+        rc = devm_request_irq(dev, irq, sha256_queue_irq, 0, dev_name(dev), q);
+        if (rc) {
+            dev_warn(dev, "Cannot request vector %d, polling queue %d\n", irq, i);
+            continue;
+        }
+        irq_set_affinity_and_hint(irq, cpumask_of(cpumask_local_spread(i, dev_to_node(dev))));
+
+        q->irq = irq;
+        iowrite32(irqDONE, q->regs + IRQ_REG(q));
     }
 
-    dev_info(dev, "SHA256 device initialized\n");
     return 0;
 }
 
-static int sha256_remove(struct platform_device *pdev) {
-    device_destroy(sha256_class, MKDEV(major, 0));
-    cdev_del(&sha256_cdev);
-    return 0;
+static void sha256_pci_remove(struct pci_dev *pdev) {
+
+    struct sha256_dev *sdev = pci_get_drvdata(pdev);
+
+    sha256_teardown(sdev);
+
+    for (int i = 0; i < sdev->nr_queues; i++) {
+        struct sha256_queue *q = &sdev->queues[i];
+
+        if (!q->irq)
+            continue;
+        iowrite32(0, q->regs + IRQ_REG(q));
+        irq_set_affinity_and_hint(q->irq, NULL);
+        devm_free_irq(&pdev->dev, q->irq, q);
+        q->irq = 0;
+    }
+    pci_free_irq_vectors(pdev);
+    put_device(&sdev->node);
 }
 
 /** Device Tree: If you’re working on an embedded system or using QEMU, ensure your device
@@ -330,7 +2090,20 @@ static struct platform_driver sha256_driver = {
     .remove = sha256_remove,
 };
 
-static int __init sha256_init(void) {
+static const struct pci_device_id sha256_pci_ids[] = {
+    { PCI_DEVICE(SHA256_PCI_VENDOR_ID, SHA256_PCI_DEVICE_ID) },
+    {},
+};
+MODULE_DEVICE_TABLE(pci, sha256_pci_ids);
+
+static struct pci_driver sha256_pci_driver = {
+    .name = DRIVER_NAME,
+    .id_table = sha256_pci_ids,
+    .probe = sha256_pci_probe,
+    .remove = sha256_pci_remove,
+};
+
+static int __init sha256_driver_init(void) {
     
     printk(KERN_INFO "SHA256: Initializing the driver\n");
 
@@ -338,7 +2111,7 @@ static int __init sha256_init(void) {
     int ret;
 
     // Allocate a major number dynamically
-    ret = alloc_chrdev_region(&dev_id, 0, 1, "sha256");
+    ret = alloc_chrdev_region(&dev_id, 0, maxDevices, "sha256");
     if (ret < 0) {
         printk(KERN_ERR "SHA256: Unable to allocate major number\n");
         return ret;
@@ -346,6 +2119,18 @@ static int __init sha256_init(void) {
     
     major = MAJOR(dev_id);
 
+    // Statistics of every probed device live under /sys/kernel/debug/sha256
+    sha256_debugfs_root = debugfs_create_dir("sha256", NULL);
+
+    // One work item per queue, unbound so the pipelines of several queues run in parallel
+    sha256_wq = alloc_workqueue("sha256", WQ_UNBOUND | WQ_HIGHPRI, 0);
+    if (!sha256_wq) {
+        unregister_chrdev_region(MKDEV(major, 0), maxDevices);
+        debugfs_remove_recursive(sha256_debugfs_root);
+        printk(KERN_ERR "SHA256: failed to allocate the workqueue\n");
+        return -ENOMEM;
+    }
+
     // Create a device class
     sha256_class = class_create(CLASS_NAME);
     
@@ -353,7 +2138,9 @@ static int __init sha256_init(void) {
     // sha256_class = class_create(THIS_MODULE, CLASS_NAME);
 
     if (IS_ERR(sha256_class)) {
-        unregister_chrdev_region(MKDEV(major, 0), 1);
+        unregister_chrdev_region(MKDEV(major, 0), maxDevices);
+        destroy_workqueue(sha256_wq);
+        debugfs_remove_recursive(sha256_debugfs_root);
         printk(KERN_ERR "SHA256: failed to register device class\n");
         return PTR_ERR(sha256_class);
     }
@@ -362,24 +2149,43 @@ static int __init sha256_init(void) {
     ret = platform_driver_register(&sha256_driver);
     if (ret != 0) {
         class_destroy(sha256_class);
-        unregister_chrdev_region(MKDEV(major, 0), 1);
+        unregister_chrdev_region(MKDEV(major, 0), maxDevices);
+        destroy_workqueue(sha256_wq);
+        debugfs_remove_recursive(sha256_debugfs_root);
         printk(KERN_ERR "SHA256: failed to register platform driver\n");
         return ret;
     }
 
+    // Register the PCI driver, a no-op on kernels without PCI support
+    ret = pci_register_driver(&sha256_pci_driver);
+    if (ret != 0) {
+        platform_driver_unregister(&sha256_driver);
+        class_destroy(sha256_class);
+        unregister_chrdev_region(MKDEV(major, 0), maxDevices);
+        destroy_workqueue(sha256_wq);
+        debugfs_remove_recursive(sha256_debugfs_root);
+        printk(KERN_ERR "SHA256: failed to register PCI driver\n");
+        return ret;
+    }
+
     printk(KERN_INFO "SHA256 driver loaded with major %d\n", major);
     return 0;
 }
 
-static void __exit sha256_exit(void) {
+static void __exit sha256_driver_exit(void) {
 
     printk(KERN_INFO "SHA256: Exiting the driver\n");
+    pci_unregister_driver(&sha256_pci_driver);
     platform_driver_unregister(&sha256_driver);
     class_destroy(sha256_class);
-    unregister_chrdev_region(MKDEV(major, 0), 1);
+    unregister_chrdev_region(MKDEV(major, 0), maxDevices);
+    destroy_workqueue(sha256_wq);
+    rcu_barrier();                              // Cache entries freed with kfree_rcu
+    ida_destroy(&sha256_minors);
+    debugfs_remove_recursive(sha256_debugfs_root);
     printk(KERN_INFO "SHA256: driver unregistered\n");
 
 }
 
-module_init(sha256_init);
-module_exit(sha256_exit);
+module_init(sha256_driver_init);
+module_exit(sha256_driver_exit);
@@ -0,0 +1,465 @@
+/**
+ ****************************************************************************************
+ * @file    virtio_sha256.c
+ * @author  Shahabuddin Danish, Areeb Ahmed
+ * @brief   This file implements the guest driver for the virtio SHA256 device.
+ ****************************************************************************************
+ * @attention
+ * The driver exposes /dev/virtio_sha256 with a single batch ioctl. Every entry of the
+ * batch is hashed zero-copy: the user pages are pinned and handed to the device as a
+ * scatter-gather list, all entries are queued before one notification is sent.
+*/
+
+/* Includes -------------------------------------------------------------------------- */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/uaccess.h>
+#include <linux/miscdevice.h>
+#include <linux/virtio.h>
+#include <linux/virtio_config.h>
+#include <linux/scatterlist.h>
+#include <linux/completion.h>
+#include <linux/mutex.h>
+#include <linux/rwsem.h>
+#include <linux/kref.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/ioctl.h>
+
+/* Kernel Module Macro Definitions --------------------------------------------------- */
+
+#define DRIVER_NAME         "virtio_sha256"
+
+#define VIRTIO_ID_SHA256    63              // Must match the QEMU device model
+
+#define SHA256_IOC_MAGIC 'k'
+#define VIRTIO_SHA256_IOC_DIGEST _IOWR(SHA256_IOC_MAGIC, 16, struct virtio_sha256_batch)
+
+#define maxBatchEntries     4096
+#define outputBufferSize    32
+
+/* Virtio Protocol ------------------------------------------------------------------- */
+
+#define VIRTIO_SHA256_T_DIGEST  0
+#define VIRTIO_SHA256_S_OK      0
+
+struct virtio_sha256_req_hdr {
+    __le32 type;
+    __le32 reserved;
+};
+
+struct virtio_sha256_resp {
+    u8 digest[outputBufferSize];
+    u8 status;
+};
+
+struct virtio_sha256_config {
+    __le32 max_segments;
+};
+
+/* Userspace Interface --------------------------------------------------------------- */
+
+struct virtio_sha256_entry {
+    __u64 data;                             // User pointer to the message
+    __u64 len;                              // Message length in bytes
+    __u64 digest;                           // User pointer to 32 bytes for the digest
+    __s32 status;                           // 0 or a negative errno, filled in by the driver
+    __u32 pad;
+};
+
+struct virtio_sha256_batch {
+    __u64 entries;                          // User pointer to an array of virtio_sha256_entry
+    __u32 count;
+    __u32 pad;
+};
+
+/* Driver Meta Information ----------------------------------------------------------- */
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("SHAHABUDDIN DANISH, AREEB AHMED");
+MODULE_DESCRIPTION("virtio SHA256 Accelerator driver");
+MODULE_VERSION("1.0");
+
+struct virtio_sha256 {
+    struct virtio_device *vdev;
+    struct virtqueue *vq;
+    spinlock_t vq_lock;                     // Protects the virtqueue against the completion callback
+    struct mutex submit_lock;               // One batch in flight at a time
+    struct rw_semaphore remove_lock;        // Held for read by ioctls using the virtqueue, drained by remove
+    bool removed;                           // Set under vq_lock, no request is queued afterwards
+    struct kref ref;                        // The binding and every open file
+    u32 max_segments;
+    struct miscdevice misc;
+};
+
+/* Header and response of one request, kmalloc'd so they can be mapped for DMA */
+struct virtio_sha256_buf {
+    struct virtio_sha256_req_hdr hdr;
+    struct virtio_sha256_resp resp;
+};
+
+/* One in-flight request, the array of these may be vmalloc memory and is never mapped */
+struct virtio_sha256_request {
+    struct virtio_sha256_buf *buf;
+    struct completion done;
+    int error;                              // -ENODEV when the device went away under the request
+    struct sg_table sgt;
+    struct page **pages;
+    int nr_pages;
+    bool queued;
+};
+
+/* Virtqueue callback, runs in interrupt context */
+static void virtio_sha256_done(struct virtqueue *vq) {
+
+    struct virtio_sha256 *vs = vq->vdev->priv;
+    struct virtio_sha256_request *req;
+    unsigned long flags;
+    unsigned int len;
+
+    spin_lock_irqsave(&vs->vq_lock, flags);
+    do {
+        virtqueue_disable_cb(vq);
+        while ((req = virtqueue_get_buf(vq, &len)) != NULL)
+            complete(&req->done);
+    } while (!virtqueue_enable_cb(vq));
+    spin_unlock_irqrestore(&vs->vq_lock, flags);
+}
+
+/**
+ * @brief Pins the user pages of one message and builds its scatter-gather table.
+ *
+ * @return returns 0 or a negative error code.
+ */
+
+static int virtio_sha256_map(struct virtio_sha256 *vs, struct virtio_sha256_request *req,
+                             unsigned long addr, size_t len) {
+
+    unsigned int offset = offset_in_page(addr);
+    size_t nr_pages;
+    int pinned;
+    int rc;
+
+    if (len == 0)
+        return 0;
+
+    // Bound len first, the page count must fit the int taken by pin_user_pages_fast
+    if (len > MAX_RW_COUNT)
+        return -E2BIG;
+    nr_pages = DIV_ROUND_UP(offset + len, PAGE_SIZE);
+    if (nr_pages > vs->max_segments)
+        return -E2BIG;
+    req->nr_pages = nr_pages;
+
+    req->pages = kvmalloc_array(req->nr_pages, sizeof(*req->pages), GFP_KERNEL);
+    if (!req->pages)
+        return -ENOMEM;
+
+    pinned = pin_user_pages_fast(addr & PAGE_MASK, req->nr_pages, 0, req->pages);
+    if (pinned != req->nr_pages) {
+        if (pinned > 0)
+            unpin_user_pages(req->pages, pinned);
+        kvfree(req->pages);
+        req->pages = NULL;
+        return pinned < 0 ? pinned : -EFAULT;
+    }
+
+    rc = sg_alloc_table_from_pages(&req->sgt, req->pages, req->nr_pages, offset, len, GFP_KERNEL);
+    if (rc) {
+        unpin_user_pages(req->pages, req->nr_pages);
+        kvfree(req->pages);
+        req->pages = NULL;
+    }
+    return rc;
+}
+
+static void virtio_sha256_unmap(struct virtio_sha256_request *req) {
+
+    if (!req->pages)
+        return;
+    sg_free_table(&req->sgt);
+    unpin_user_pages(req->pages, req->nr_pages);
+    kvfree(req->pages);
+    req->pages = NULL;
+}
+
+/* Queue one request, called with vq_lock held */
+static int virtio_sha256_queue(struct virtio_sha256 *vs, struct virtio_sha256_request *req) {
+
+    struct scatterlist hdr_sg, resp_sg;
+    struct scatterlist *sgs[3];
+    unsigned int out = 0;
+
+    sg_init_one(&hdr_sg, &req->buf->hdr, sizeof(req->buf->hdr));
+    sgs[out++] = &hdr_sg;
+    if (req->pages)
+        sgs[out++] = req->sgt.sgl;
+    sg_init_one(&resp_sg, &req->buf->resp, sizeof(req->buf->resp));
+    sgs[out] = &resp_sg;
+
+    return virtqueue_add_sgs(vs->vq, sgs, out, 1, req, GFP_ATOMIC);
+}
+
+/**
+ * @brief Hashes a batch of user buffers. Requests are added to the virtqueue back to back
+ * and the device is notified once; when the ring is full the queued part is kicked and
+ * the oldest request is waited for before continuing.
+ */
+
+static long virtio_sha256_digest_batch(struct virtio_sha256 *vs, struct virtio_sha256_batch __user *ubatch) {
+
+    struct virtio_sha256_batch batch;
+    struct virtio_sha256_entry *entries;
+    struct virtio_sha256_request *reqs;
+    u32 oldest = 0;
+    long rc = 0;
+
+    if (copy_from_user(&batch, ubatch, sizeof(batch)))
+        return -EFAULT;
+    if (batch.count == 0 || batch.count > maxBatchEntries)
+        return -EINVAL;
+
+    entries = kvmalloc_array(batch.count, sizeof(*entries), GFP_KERNEL);
+    reqs = kvcalloc(batch.count, sizeof(*reqs), GFP_KERNEL);
+    if (!entries || !reqs) {
+        rc = -ENOMEM;
+        goto out_free;
+    }
+    if (copy_from_user(entries, u64_to_user_ptr(batch.entries), batch.count * sizeof(*entries))) {
+        rc = -EFAULT;
+        goto out_free;
+    }
+
+    mutex_lock(&vs->submit_lock);
+
+    for (u32 i = 0; i < batch.count; i++) {
+        struct virtio_sha256_request *req = &reqs[i];
+        int err;
+
+        init_completion(&req->done);
+        req->buf = kmalloc(sizeof(*req->buf), GFP_KERNEL);
+        if (!req->buf) {
+            entries[i].status = -ENOMEM;
+            continue;
+        }
+        req->buf->hdr.type = cpu_to_le32(VIRTIO_SHA256_T_DIGEST);
+        req->buf->hdr.reserved = 0;
+
+        entries[i].status = virtio_sha256_map(vs, req, entries[i].data, entries[i].len);
+        if (entries[i].status)
+            continue;
+
+        spin_lock_irq(&vs->vq_lock);
+        err = vs->removed ? -ENODEV : virtio_sha256_queue(vs, req);
+        while (err == -ENOSPC && oldest < i) {
+            // Ring full: let the device drain what is queued so far
+            virtqueue_kick(vs->vq);
+            spin_unlock_irq(&vs->vq_lock);
+            if (reqs[oldest].queued)
+                wait_for_completion(&reqs[oldest].done);
+            oldest++;
+            spin_lock_irq(&vs->vq_lock);
+            err = vs->removed ? -ENODEV : virtio_sha256_queue(vs, req);
+        }
+        spin_unlock_irq(&vs->vq_lock);
+
+        if (err) {
+            entries[i].status = err;
+            virtio_sha256_unmap(req);
+            continue;
+        }
+        req->queued = true;
+    }
+
+    // One notification for everything still pending
+    spin_lock_irq(&vs->vq_lock);
+    if (!vs->removed)
+        virtqueue_kick(vs->vq);
+    spin_unlock_irq(&vs->vq_lock);
+
+    for (u32 i = 0; i < batch.count; i++) {
+        struct virtio_sha256_request *req = &reqs[i];
+
+        if (!req->queued)
+            continue;
+        wait_for_completion(&req->done);
+        virtio_sha256_unmap(req);
+
+        if (req->error)
+            entries[i].status = req->error;
+        else if (req->buf->resp.status != VIRTIO_SHA256_S_OK)
+            entries[i].status = -EIO;
+        else if (copy_to_user(u64_to_user_ptr(entries[i].digest), req->buf->resp.digest, outputBufferSize))
+            entries[i].status = -EFAULT;
+    }
+
+    mutex_unlock(&vs->submit_lock);
+
+    if (copy_to_user(u64_to_user_ptr(batch.entries), entries, batch.count * sizeof(*entries)))
+        rc = -EFAULT;
+
+out_free:
+    for (u32 i = 0; reqs && i < batch.count; i++)
+        kfree(reqs[i].buf);
+    kvfree(reqs);
+    kvfree(entries);
+    return rc;
+}
+
+static void virtio_sha256_free(struct kref *ref) {
+    kfree(container_of(ref, struct virtio_sha256, ref));
+}
+
+/* misc_open() calls this under misc_mtx, so the device cannot be removed meanwhile */
+static int virtio_sha256_open(struct inode *inode, struct file *filep) {
+
+    struct virtio_sha256 *vs = container_of(filep->private_data, struct virtio_sha256, misc);
+
+    kref_get(&vs->ref);
+    return 0;
+}
+
+static int virtio_sha256_release(struct inode *inode, struct file *filep) {
+
+    struct virtio_sha256 *vs = container_of(filep->private_data, struct virtio_sha256, misc);
+
+    kref_put(&vs->ref, virtio_sha256_free);
+    return 0;
+}
+
+static long virtio_sha256_ioctl(struct file *filep, unsigned int cmd, unsigned long arg) {
+
+    struct virtio_sha256 *vs = container_of(filep->private_data, struct virtio_sha256, misc);
+    long rc;
+
+    // Files opened before the device was unbound outlive it, their calls fail
+    down_read(&vs->remove_lock);
+    if (READ_ONCE(vs->removed)) {
+        up_read(&vs->remove_lock);
+        return -ENODEV;
+    }
+
+    switch (cmd) {
+        case VIRTIO_SHA256_IOC_DIGEST:
+            rc = virtio_sha256_digest_batch(vs, (struct virtio_sha256_batch __user *)arg);
+            break;
+
+        default:
+            rc = -ENOTTY;
+            break;
+    }
+
+    up_read(&vs->remove_lock);
+    return rc;
+}
+
+static const struct file_operations virtio_sha256_fops = {
+    .owner = THIS_MODULE,
+    .open = virtio_sha256_open,
+    .release = virtio_sha256_release,
+    .unlocked_ioctl = virtio_sha256_ioctl,
+    .compat_ioctl = compat_ptr_ioctl,
+};
+
+/**
+ * @brief Binds to a virtio SHA256 device: sets up the request queue, reads the segment
+ * limit from the config space and registers the misc device.
+ */
+
+static int virtio_sha256_probe(struct virtio_device *vdev) {
+
+    struct virtio_sha256 *vs;
+    int rc;
+
+    vs = kzalloc(sizeof(*vs), GFP_KERNEL);
+    if (!vs)
+        return -ENOMEM;
+
+    vs->vdev = vdev;
+    vdev->priv = vs;
+    spin_lock_init(&vs->vq_lock);
+    mutex_init(&vs->submit_lock);
+    init_rwsem(&vs->remove_lock);
+    kref_init(&vs->ref);
+
+    vs->vq = virtio_find_single_vq(vdev, virtio_sha256_done, "requests");
+    if (IS_ERR(vs->vq)) {
+        rc = PTR_ERR(vs->vq);
+        goto err_free;
+    }
+
+    virtio_cread_le(vdev, struct virtio_sha256_config, max_segments, &vs->max_segments);
+    if (vs->max_segments == 0)
+        vs->max_segments = 1;
+
+    vs->misc.minor = MISC_DYNAMIC_MINOR;
+    vs->misc.name = DRIVER_NAME;
+    vs->misc.fops = &virtio_sha256_fops;
+
+    virtio_device_ready(vdev);
+
+    rc = misc_register(&vs->misc);
+    if (rc)
+        goto err_reset;
+
+    dev_info(&vdev->dev, "virtio SHA256 device ready, %u segments per request\n", vs->max_segments);
+    return 0;
+
+err_reset:
+    virtio_reset_device(vdev);
+    vdev->config->del_vqs(vdev);
+err_free:
+    kfree(vs);
+    return rc;
+}
+
+/**
+ * @brief Unbinds the device. Requests still on the ring are completed with -ENODEV once
+ * the device is reset, then the ioctls that were waiting for them are drained before the
+ * virtqueue goes away. The state itself lives until the last open file is released.
+ */
+
+static void virtio_sha256_remove(struct virtio_device *vdev) {
+
+    struct virtio_sha256 *vs = vdev->priv;
+    struct virtio_sha256_request *req;
+
+    misc_deregister(&vs->misc);
+
+    spin_lock_irq(&vs->vq_lock);
+    vs->removed = true;
+    spin_unlock_irq(&vs->vq_lock);
+
+    virtio_reset_device(vdev);
+
+    spin_lock_irq(&vs->vq_lock);
+    while ((req = virtqueue_detach_unused_buf(vs->vq)) != NULL) {
+        req->error = -ENODEV;
+        complete(&req->done);
+    }
+    spin_unlock_irq(&vs->vq_lock);
+
+    down_write(&vs->remove_lock);
+    vdev->config->del_vqs(vdev);
+    up_write(&vs->remove_lock);
+
+    kref_put(&vs->ref, virtio_sha256_free);
+}
+
+static const struct virtio_device_id virtio_sha256_id_table[] = {
+    { VIRTIO_ID_SHA256, VIRTIO_DEV_ANY_ID },
+    { 0 },
+};
+MODULE_DEVICE_TABLE(virtio, virtio_sha256_id_table);
+
+static struct virtio_driver virtio_sha256_driver = {
+    .driver.name = DRIVER_NAME,
+    .driver.owner = THIS_MODULE,
+    .id_table = virtio_sha256_id_table,
+    .probe = virtio_sha256_probe,
+    .remove = virtio_sha256_remove,
+};
+
+module_virtio_driver(virtio_sha256_driver);
@@ -0,0 +1,720 @@
+/**
+ ****************************************************************************************
+ * @file    sha256_bench.c
+ * @brief   Host-side known-answer tests and throughput benchmark for the SHA256 core of
+ *          sha256_accelerator.c, built against the QEMU stubs in this directory.
+ ****************************************************************************************
+ * @attention
+ * Usage: sha256_bench [--test] [--sizes a,b,c] [--min-time ms] [--save file]
+ *                     [--baseline file] [--max-regression pct] [--trace file]
+ *
+ * The known-answer tests always run first. With --baseline the measured throughput of
+ * every backend/size pair is compared to the saved one and the program exits with 1 if
+ * any of them regressed by more than --max-regression percent. With --trace the device
+ * checks with the default window are captured for sha256_replay.
+ */
+
+/* Includes -------------------------------------------------------------------------- */
+
+#include "qemu/osdep.h"
+#include "hw/misc/sha256_accelerator.h"
+
+#include <time.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLE_COUNTER 1
+static inline uint64_t read_cycles(void) { return __rdtsc(); }
+#else
+#define HAVE_CYCLE_COUNTER 0
+static inline uint64_t read_cycles(void) { return 0; }
+#endif
+
+/* Bench Macros Definitions ---------------------------------------------------------- */
+
+#define MAX_SIZES           16
+#define MAX_RESULTS         (MAX_SIZES * 8)
+#define DEFAULT_MIN_TIME    200         // Minimum measuring time per backend/size pair in ms
+#define DEFAULT_REGRESSION  10.0        // Allowed throughput drop against the baseline in %
+
+/* FIPS 180-4 Known Answer Tests ----------------------------------------------------- */
+
+typedef struct {
+    const char *message;
+    int repeat;                 // Number of times the message is repeated
+    const char *digest;
+} SHA256Vector;
+
+static const SHA256Vector vectors[] = {
+    { "", 1,
+      "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+    { "abc", 1,
+      "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+    { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+      "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+    { "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopq"
+      "klmnopqrlmnopqrsmnopqrstnopqrstu", 1,
+      "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1" },
+    { "a", 1000000,
+      "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" },
+};
+
+typedef struct {
+    const char *backend;
+    size_t size;
+    double mbps;
+} BenchResult;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void digest_to_hex(const uint8_t *in, char *out) {
+    for (int i = 0; i < 32; ++i) {
+        sprintf(out + i * 2, "%02x", in[i]);
+    }
+}
+
+/**
+ * @brief Runs every known-answer vector through every compression backend.
+ *
+ * @return returns the number of failed vector/backend pairs.
+ */
+
+static int run_vectors(void) {
+
+    int failures = 0;
+    char hex[65];
+
+    for (int b = 0; b < sha256_backend_count; ++b) {
+        sha256_select_backend(sha256_backends[b].name);
+
+        for (size_t v = 0; v < sizeof(vectors) / sizeof(vectors[0]); ++v) {
+            size_t len = strlen(vectors[v].message);
+            char *msg = malloc(len * vectors[v].repeat + 1);
+
+            for (int r = 0; r < vectors[v].repeat; ++r) {
+                memcpy(msg + r * len, vectors[v].message, len);
+            }
+            msg[len * vectors[v].repeat] = '\0';
+
+            perform_sha256_hashing(msg, len * vectors[v].repeat);
+            digest_to_hex(digest, hex);
+            free(msg);
+
+            if (strcmp(hex, vectors[v].digest) != 0) {
+                printf("FAIL %-10s vector %zu: got %s expected %s\n",
+                       sha256_backends[b].name, v, hex, vectors[v].digest);
+                failures++;
+            }
+        }
+    }
+
+    printf("known-answer tests: %s (%d backends x %zu vectors)\n", failures ? "FAILED" : "passed",
+           sha256_backend_count, sizeof(vectors) / sizeof(vectors[0]));
+    return failures;
+}
+
+/* Device helpers, offsets follow the register map of sha256_accelerator.c */
+#define DEV_CTRL_REG        0x08
+#define DEV_STATUS_REG      0x0C
+#define DEV_INPUT_REG       0x10
+#define DEV_EXT_REG(n)      (DEV_INPUT_REG + (n) + 32)
+
+/* PBKDF2-HMAC-SHA256 from RFC 7914 section 11 and the RFC 6070 inputs, RFC 5869 test cases 1 and 3 */
+typedef struct {
+    uint32_t op;                // CTRL_OP of the start
+    const char *key, *salt, *info;  // Hex
+    uint32_t iterations;
+    const char *derived;
+} KdfVector;
+
+static const KdfVector kdfVectors[] = {
+    { 0x1, "706173737764", "73616c74", "", 1,
+      "55ac046e56e3089fec1691c22544b605f94185216dde0465e68b9d57c20dacbc"
+      "49ca9cccf179b645991664b39d77ef317c71b845b1e30bd509112041d3a19783" },
+    { 0x1, "70617373776f7264", "73616c74", "", 4096,
+      "c5e478d59288c841aa530db6845c4c8d962893a001ce4e11a4963873aa98134a" },
+    { 0x2, "0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b", "000102030405060708090a0b0c",
+      "f0f1f2f3f4f5f6f7f8f9", 0,
+      "3cb25f25faacd57a90434f64d0362f2a2d2d0a90cf1a5a4c5db02d56ecc4c5bf34007208d5b887185865" },
+    { 0x2, "0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b", "", "", 0,
+      "8da4e775a563c18f715f802a063c5a31b8a11f5c5ee1879ec3454e5f3c738d2d9d201395faa4b61a96c8" },
+    { 0x3, "077709362c2e32df0ddc3f0dc47bba6390b6c73bb50f9c3122ec844ad7c2b3e5", "",
+      "f0f1f2f3f4f5f6f7f8f9", 0,
+      "3cb25f25faacd57a90434f64d0362f2a2d2d0a90cf1a5a4c5db02d56ecc4c5bf34007208d5b887185865" },
+};
+
+/* Appends the bytes of a hex string, returns the new length */
+static size_t append_hex(uint8_t *buf, size_t len, const char *hex) {
+
+    for (; hex[0] && hex[1]; hex += 2) {
+        unsigned int byte;
+        sscanf(hex, "%2x", &byte);
+        buf[len++] = byte;
+    }
+    return len;
+}
+
+static void dev_wait_bank(MemoryRegion *mr, int bank) {
+    while (stub_mmio_read(mr, DEV_STATUS_REG, 4) & (0x2 << (bank * 4))) {
+        /* The worker thread hashes asynchronously */
+    }
+}
+
+/* Loads len bytes into the given bank and starts op on it, more selects a non-final part */
+static void dev_submit_op(MemoryRegion *mr, uint32_t inputSize, int bank, const char *data, size_t len, bool more,
+                          uint32_t op) {
+
+    dev_wait_bank(mr, bank);
+    stub_mmio_write(mr, DEV_CTRL_REG, 0x8 | (bank << 1), 4);            // Select the bank
+    for (size_t i = 0; i < len; i += 4) {
+        uint32_t word = 0;
+        memcpy(&word, data + i, MIN(len - i, 4));
+        stub_mmio_write(mr, DEV_INPUT_REG + i, word, 4);
+    }
+    stub_mmio_write(mr, DEV_INPUT_REG + inputSize + 32, len, 4);        // LEN_REG
+    stub_mmio_write(mr, DEV_CTRL_REG, 0x1 | (bank << 1) | (more ? 0x4 : 0) | (op << 4), 4);
+}
+
+static void dev_submit(MemoryRegion *mr, uint32_t inputSize, int bank, const char *data, size_t len, bool more) {
+    dev_submit_op(mr, inputSize, bank, data, len, more, 0);
+}
+
+/**
+ * @brief Instantiates sha256_device with the given input window and hashes messages
+ * through the MMIO handlers: "abc", a full window, a full window relying on the legacy
+ * strnlen length and a message streamed over both banks. Also runs the PBKDF2 and HKDF
+ * operations against their RFC test vectors and checks the chunk records of a stream.
+ *
+ * @return returns the number of failed checks.
+ */
+
+static int run_device_checks(uint32_t inputSize, const char *tracePath) {
+
+    Object *obj = object_new("sha256_device");
+    Error *err = NULL;
+    MemoryRegion *mr;
+    int failures = 0;
+    char hex[65];
+    uint8_t out[32];
+
+    object_property_set_uint(obj, "input-size", inputSize, NULL);
+    if (tracePath) {
+        object_property_set_str(obj, "trace-file", tracePath, NULL);
+    }
+    if (!qdev_realize(DEVICE(obj), NULL, &err)) {
+        printf("FAIL device realize (input-size %u): %s\n", inputSize, error_get_pretty(err));
+        error_free(err);
+        return 1;
+    }
+    mr = sysbus_mmio_get_region(SYS_BUS_DEVICE(obj), 0);
+
+    if (stub_mmio_read(mr, 0x4, 4) != inputSize) {
+        printf("FAIL device capability register does not report %u\n", inputSize);
+        failures++;
+    }
+    if (stub_mmio_read(mr, DEV_INPUT_REG + inputSize + 32 + 0x08, 4) != 1) {
+        printf("FAIL device queue count register does not report a single context\n");
+        failures++;
+    }
+
+    // Window read-back must not sign-extend bytes >= 0x80
+    stub_mmio_write(mr, DEV_INPUT_REG, 0x80fffe7f, 4);
+    if (stub_mmio_read(mr, DEV_INPUT_REG + 1, 1) != 0xfe || stub_mmio_read(mr, DEV_INPUT_REG + 2, 2) != 0x80ff ||
+        stub_mmio_read(mr, DEV_INPUT_REG, 4) != 0x80fffe7f) {
+        printf("FAIL device input window read-back of bytes >= 0x80\n");
+        failures++;
+    }
+
+    // Compress-on-write must undo absorbed blocks that are rewritten or lie past LEN_REG
+    for (int pass = 0; pass < 2; ++pass) {
+        SHA256Core *core = mr->subregions[0]->opaque;
+        SHA256CoreStats before, after;
+        char msg[256];
+        size_t len = pass == 0 ? sizeof(msg) : 100;
+
+        memset(msg, 'x', sizeof(msg));
+        stub_mmio_write(mr, DEV_CTRL_REG, 0, 4);
+        sha256_core_get_stats(core, &before);
+        for (size_t i = 0; i < sizeof(msg); i += 4) {
+            stub_mmio_write(mr, DEV_INPUT_REG + i, 0x78787878, 4);
+        }
+        if (pass == 0) {
+            memcpy(msg + 8, "ABCD", 4);
+            stub_mmio_write(mr, DEV_INPUT_REG + 8, 0x44434241, 4);
+        }
+        stub_mmio_write(mr, DEV_INPUT_REG + inputSize + 32, len, 4);
+        stub_mmio_write(mr, DEV_CTRL_REG, 0x1, 4);
+        dev_wait_bank(mr, 0);
+        sha256_core_get_stats(core, &after);
+
+        for (int i = 0; i < 32; ++i) {
+            out[i] = stub_mmio_read(mr, DEV_INPUT_REG + inputSize + i, 1);
+        }
+        perform_sha256_hashing(msg, len);
+        // Dropped blocks are hashed again, the count holds each block of the message once
+        if (after.blocks - before.blocks != len / 64 + (len % 64 > 55 ? 2 : 1)) {
+            printf("FAIL device block count %" PRIu64 " after %s (input-size %u)\n", after.blocks - before.blocks,
+                   pass == 0 ? "rewriting absorbed bytes" : "a length short of the absorbed blocks", inputSize);
+            failures++;
+        }
+        if (memcmp(out, digest, 32) != 0) {
+            printf("FAIL device digest after %s (input-size %u)\n",
+                   pass == 0 ? "rewriting absorbed bytes" : "a length short of the absorbed blocks", inputSize);
+            failures++;
+        }
+    }
+
+    // Counters of the monitor: one job per start, compressions include the padding block
+    {
+        SHA256Core *core = mr->subregions[0]->opaque;
+        SHA256CoreStats before, after;
+        char msg[64];
+
+        memset(msg, 'y', sizeof(msg));
+        stub_mmio_write(mr, DEV_CTRL_REG, 0, 4);
+        sha256_core_get_stats(core, &before);
+        dev_submit(mr, inputSize, 0, msg, sizeof(msg), false);
+        dev_wait_bank(mr, 0);
+        sha256_core_get_stats(core, &after);
+        if (after.jobs != before.jobs + 1 || after.bytes != before.bytes + sizeof(msg) ||
+            after.blocks != before.blocks + 2 || after.queueDepth != 0) {
+            printf("FAIL device statistics: %" PRIu64 " jobs, %" PRIu64 " bytes, %" PRIu64 " blocks for one "
+                   "64 byte message\n", after.jobs - before.jobs, after.bytes - before.bytes,
+                   after.blocks - before.blocks);
+            failures++;
+        }
+    }
+
+    // Key derivation runs the whole chain in one job, the key comes back in the window
+    for (size_t v = 0; v < sizeof(kdfVectors) / sizeof(kdfVectors[0]); ++v) {
+        const KdfVector *kv = &kdfVectors[v];
+        uint8_t in[128], derived[128];
+        size_t keyLen = append_hex(in, 0, kv->key);
+        size_t saltLen = append_hex(in, keyLen, kv->salt) - keyLen;
+        size_t infoLen = append_hex(in, keyLen + saltLen, kv->info) - keyLen - saltLen;
+        size_t outLen = strlen(kv->derived) / 2;
+        char got[257];
+
+        stub_mmio_write(mr, DEV_CTRL_REG, 0, 4);
+        for (size_t i = 0; i < keyLen + saltLen + infoLen; ++i) {
+            stub_mmio_write(mr, DEV_INPUT_REG + i, in[i], 1);
+        }
+        stub_mmio_write(mr, DEV_EXT_REG(inputSize) + 0x0C, kv->iterations, 4);
+        stub_mmio_write(mr, DEV_EXT_REG(inputSize) + 0x10, keyLen, 4);
+        stub_mmio_write(mr, DEV_EXT_REG(inputSize) + 0x14, saltLen, 4);
+        stub_mmio_write(mr, DEV_EXT_REG(inputSize) + 0x18, infoLen, 4);
+        stub_mmio_write(mr, DEV_EXT_REG(inputSize) + 0x1C, outLen, 4);
+        stub_mmio_write(mr, DEV_CTRL_REG, 0x1 | (kv->op << 4), 4);
+        dev_wait_bank(mr, 0);
+
+        for (size_t i = 0; i < outLen; ++i) {
+            derived[i] = stub_mmio_read(mr, DEV_INPUT_REG + i, 1);
+            sprintf(got + 2 * i, "%02x", derived[i]);
+        }
+        if (strcmp(got, kv->derived) != 0 ||
+            stub_mmio_read(mr, DEV_INPUT_REG + inputSize + 4, 4) != (derived[4] | derived[5] << 8 |
+                                                                    derived[6] << 16 | (uint32_t)derived[7] << 24)) {
+            printf("FAIL device key derivation %zu (op %u, input-size %u): %s\n", v, kv->op, inputSize, got);
+            failures++;
+        }
+    }
+
+    // A PBKDF2 chain over the work cap is refused at start, reset would otherwise wait on it
+    stub_mmio_write(mr, DEV_CTRL_REG, 0, 4);
+    stub_mmio_write(mr, DEV_EXT_REG(inputSize) + 0x0C, 0xFFFFFFFF, 4);
+    stub_mmio_write(mr, DEV_EXT_REG(inputSize) + 0x10, 8, 4);
+    stub_mmio_write(mr, DEV_EXT_REG(inputSize) + 0x14, 4, 4);
+    stub_mmio_write(mr, DEV_EXT_REG(inputSize) + 0x18, 0, 4);
+    stub_mmio_write(mr, DEV_EXT_REG(inputSize) + 0x1C, 32, 4);
+    stub_mmio_write(mr, DEV_CTRL_REG, 0x1 | (0x1 << 4), 4);
+    if (stub_mmio_read(mr, DEV_STATUS_REG, 4) != 0) {
+        printf("FAIL device accepted an unbounded PBKDF2 iteration count (input-size %u)\n", inputSize);
+        failures++;
+    }
+    stub_mmio_write(mr, DEV_CTRL_REG, 0, 4);
+
+    // Chunking: records tile the stream, hash their chunk and match a one-shot run on the host
+    {
+        SHA256CdcParams cdc = { .minSize = 256, .avgSize = 1024, .maxSize = 4096 };
+        size_t len = inputSize * 5 + 17, numRecords = 0, numExpected;
+        uint8_t *msg = malloc(len), *records = malloc(len), *expected = malloc(len);
+        uint64_t next = 0;
+        SHA256CdcState st;
+        int bank = 0;
+        bool ok = true;
+
+        for (size_t i = 0; i < len; ++i) {
+            msg[i] = (i * 2654435761u) >> 13;
+        }
+        stub_mmio_write(mr, DEV_CTRL_REG, 0, 4);
+        stub_mmio_write(mr, DEV_EXT_REG(inputSize) + 0x20, cdc.minSize, 4);
+        stub_mmio_write(mr, DEV_EXT_REG(inputSize) + 0x24, cdc.avgSize, 4);
+        stub_mmio_write(mr, DEV_EXT_REG(inputSize) + 0x28, cdc.maxSize, 4);
+        for (size_t off = 0; off < len; off += inputSize, bank ^= 1) {
+            size_t n = MIN(len - off, inputSize);
+            uint32_t count;
+
+            dev_submit_op(mr, inputSize, bank, (const char *)msg + off, n, off + n < len, 0x4);
+            dev_wait_bank(mr, bank);
+            stub_mmio_write(mr, DEV_CTRL_REG, 0x8 | (bank << 1), 4);
+            count = stub_mmio_read(mr, DEV_EXT_REG(inputSize) + 0x2C, 4);
+            for (size_t i = 0; i < count * SHA256_CDC_RECORD_SIZE; ++i) {
+                records[numRecords * SHA256_CDC_RECORD_SIZE + i] = stub_mmio_read(mr, DEV_INPUT_REG + i, 1);
+            }
+            numRecords += count;
+        }
+
+        sha256_cdc_init(&st);
+        numExpected = sha256_cdc_update(&st, &cdc, msg, len / 3, false, expected);
+        numExpected += sha256_cdc_update(&st, &cdc, msg + len / 3, len - len / 3, true,
+                                         expected + numExpected * SHA256_CDC_RECORD_SIZE);
+
+        for (size_t r = 0; r < numRecords && ok; ++r) {
+            const uint8_t *rec = records + r * SHA256_CDC_RECORD_SIZE;
+            uint64_t offset = 0;
+            uint32_t length = 0;
+            SHA256Context ctx;
+            uint8_t chunkDigest[32];
+
+            for (int i = 7; i >= 0; --i) {
+                offset = offset << 8 | rec[i];
+            }
+            for (int i = 3; i >= 0; --i) {
+                length = length << 8 | rec[8 + i];
+            }
+            sha256_init(&ctx);
+            sha256_update(&ctx, msg + offset, length);
+            sha256_final(&ctx, chunkDigest);
+            ok = offset == next && length <= cdc.maxSize && (length >= cdc.minSize || r + 1 == numRecords) &&
+                 memcmp(rec + 16, chunkDigest, 32) == 0;
+            next += length;
+        }
+        if (!ok || next != len || numRecords < 2 || numRecords != numExpected ||
+            memcmp(records, expected, numRecords * SHA256_CDC_RECORD_SIZE) != 0) {
+            printf("FAIL device chunking of %zu bytes (input-size %u): %zu records, %zu on the host\n", len,
+                   inputSize, numRecords, numExpected);
+            failures++;
+        }
+        free(msg);
+        free(records);
+        free(expected);
+    }
+
+    for (int pass = 0; pass < 4; ++pass) {
+        size_t len = pass == 0 ? 3 : pass == 3 ? inputSize * 5 + 17 : inputSize;
+        char *msg = malloc(len + 1);
+        int bank = 0;
+
+        for (size_t i = 0; i < len; ++i) {
+            msg[i] = pass == 0 ? "abc"[i] : (char)('a' + i % 26);
+        }
+        msg[len] = '\0';
+
+        stub_mmio_write(mr, DEV_CTRL_REG, 0, 4);                      // Reset clears the windows
+        if (pass == 2) {
+            // Legacy flow: byte writes, no LEN_REG, start with a plain deviceEN
+            for (size_t i = 0; i < len; ++i) {
+                stub_mmio_write(mr, DEV_INPUT_REG + i, msg[i], 1);
+            }
+            stub_mmio_write(mr, DEV_CTRL_REG, 1, 4);
+        } else {
+            for (size_t off = 0; off < len; off += inputSize, bank ^= 1) {
+                size_t n = MIN(len - off, inputSize);
+                dev_submit(mr, inputSize, bank, msg + off, n, off + n < len);
+            }
+            bank ^= 1;
+        }
+        dev_wait_bank(mr, bank);
+
+        for (int i = 0; i < 32; ++i) {
+            out[i] = stub_mmio_read(mr, DEV_INPUT_REG + inputSize + i, 1);
+        }
+
+        perform_sha256_hashing(msg, len);
+        if (memcmp(out, digest, 32) != 0) {
+            digest_to_hex(out, hex);
+            printf("FAIL device digest for %zu bytes (input-size %u): %s\n", len, inputSize, hex);
+            failures++;
+        }
+        free(msg);
+    }
+
+    object_unref(obj);
+    return failures;
+}
+
+typedef struct {
+    MemoryRegion *ctx;                          // Register page of one context
+    uint32_t index;
+    int failures;
+} ContextJob;
+
+/* Hashes messages of varying length on one context while the other threads use theirs */
+static void *context_thread(void *opaque) {
+
+    ContextJob *job = opaque;
+    uint32_t inputSize = 1024;
+    char msg[1024];
+    uint8_t out[32], expected[32];
+    SHA256Context ctx;
+    int bank = 0;
+
+    for (int iter = 0; iter < 200; ++iter, bank ^= 1) {
+        size_t len = (job->index * 97 + iter * 31) % inputSize + 1;
+
+        memset(msg, 'a' + (job->index + iter) % 26, len);
+        dev_submit(job->ctx, inputSize, bank, msg, len, false);
+        dev_wait_bank(job->ctx, bank);
+        for (int i = 0; i < 32; ++i) {
+            out[i] = stub_mmio_read(job->ctx, DEV_INPUT_REG + inputSize + i, 1);
+        }
+
+        sha256_init(&ctx);
+        sha256_update(&ctx, (const uint8_t *)msg, len);
+        sha256_final(&ctx, expected);
+        if (memcmp(out, expected, 32) != 0) {
+            job->failures++;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Drives every context of a multi-context sha256_device from its own thread, the
+ * way vCPUs do once the regions are outside the BQL, and checks that no digest mixes.
+ *
+ * @return returns the number of failed checks.
+ */
+
+static int run_context_checks(uint32_t numContexts) {
+
+    Object *obj = object_new("sha256_device");
+    ContextJob jobs[numContexts];
+    pthread_t threads[numContexts];
+    Error *err = NULL;
+    MemoryRegion *mr;
+    int failures = 0;
+
+    object_property_set_uint(obj, "contexts", numContexts, NULL);
+    if (!qdev_realize(DEVICE(obj), NULL, &err)) {
+        printf("FAIL device realize (contexts %u): %s\n", numContexts, error_get_pretty(err));
+        error_free(err);
+        return 1;
+    }
+    mr = sysbus_mmio_get_region(SYS_BUS_DEVICE(obj), 0);
+
+    for (uint32_t i = 0; i < numContexts; ++i) {
+        jobs[i] = (ContextJob){ .ctx = mr->subregions[i], .index = i };
+        if (mr->subregions[i]->globalLocking ||
+            stub_mmio_read(jobs[i].ctx, DEV_INPUT_REG + 1024 + 32 + 0x08, 4) != numContexts) {
+            printf("FAIL context %u is not a BQL-free page reporting %u contexts\n", i, numContexts);
+            failures++;
+        }
+        pthread_create(&threads[i], NULL, context_thread, &jobs[i]);
+    }
+    for (uint32_t i = 0; i < numContexts; ++i) {
+        pthread_join(threads[i], NULL);
+        if (jobs[i].failures) {
+            printf("FAIL context %u: %d wrong digests\n", i, jobs[i].failures);
+            failures += jobs[i].failures;
+        }
+    }
+
+    object_unref(obj);
+    return failures;
+}
+
+/* One-shot path used by the lab reference, streaming path used by the device jobs */
+static void hash_stream(const char *msg, size_t size) {
+
+    SHA256Context ctx;
+
+    sha256_init(&ctx);
+    sha256_update(&ctx, (const uint8_t *)msg, size);
+    sha256_final(&ctx, digest);
+}
+
+static void hash_oneshot(const char *msg, size_t size) {
+    perform_sha256_hashing((char *)msg, size);
+}
+
+/**
+ * @brief Measures one hashing path for one input size with the active backend.
+ * Iterations are doubled until the batch takes at least min_time_ms.
+ */
+
+static double bench_one(void (*hash)(const char *, size_t), size_t size, int min_time_ms, double *cycles_per_byte) {
+
+    char *msg = malloc(size + 1);
+    long iterations = 1;
+    double elapsed = 0;
+    uint64_t cycles = 0;
+
+    for (size_t i = 0; i < size; ++i) {
+        msg[i] = 'a' + (i % 26);
+    }
+    msg[size] = '\0';
+
+    hash(msg, size);                            // Warm up caches and the allocator
+
+    while (elapsed < min_time_ms * 1e6) {
+        iterations *= 2;
+        uint64_t c0 = read_cycles();
+        double t0 = now_ns();
+        for (long i = 0; i < iterations; ++i) {
+            hash(msg, size);
+        }
+        elapsed = now_ns() - t0;
+        cycles = read_cycles() - c0;
+    }
+
+    free(msg);
+    *cycles_per_byte = HAVE_CYCLE_COUNTER ? (double)cycles / ((double)iterations * size) : 0;
+    return ((double)iterations * size) / (elapsed / 1e9) / 1e6;
+}
+
+static int load_baseline(const char *path, BenchResult *out, char names[][32]) {
+
+    FILE *fp = fopen(path, "r");
+    int n = 0;
+
+    if (fp == NULL) {
+        perror("Failed to open the baseline");
+        return -1;
+    }
+    while (n < MAX_RESULTS && fscanf(fp, "%31s %zu %lf", names[n], &out[n].size, &out[n].mbps) == 3) {
+        out[n].backend = names[n];
+        n++;
+    }
+    fclose(fp);
+    return n;
+}
+
+static int parse_sizes(const char *arg, size_t *sizes) {
+
+    int n = 0;
+    char *copy = strdup(arg);
+
+    for (char *tok = strtok(copy, ","); tok != NULL && n < MAX_SIZES; tok = strtok(NULL, ",")) {
+        sizes[n++] = strtoul(tok, NULL, 0);
+    }
+    free(copy);
+    return n;
+}
+
+int main(int argc, char **argv) {
+
+    size_t sizes[MAX_SIZES] = { 16, 55, 64, 256, 1024, 4096, 65536 };
+    int numSizes = 7;
+    int minTime = DEFAULT_MIN_TIME;
+    double maxRegression = DEFAULT_REGRESSION;
+    const char *savePath = NULL;
+    const char *baselinePath = NULL;
+    const char *tracePath = NULL;
+    bool testOnly = false;
+
+    BenchResult results[MAX_RESULTS];
+    char labels[MAX_RESULTS][32];
+    int numResults = 0;
+    int regressions = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--test") == 0) {
+            testOnly = true;
+        } else if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            numSizes = parse_sizes(argv[++i], sizes);
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            minTime = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+            savePath = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else if (strcmp(argv[i], "--max-regression") == 0 && i + 1 < argc) {
+            maxRegression = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--test] [--sizes a,b,c] [--min-time ms] [--save file]"
+                    " [--baseline file] [--max-regression pct] [--trace file]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (run_vectors() != 0) {
+        return 2;
+    }
+    if (run_device_checks(1024, tracePath) + run_device_checks(65536, NULL) + run_context_checks(4) != 0) {
+        return 2;
+    }
+    printf("device checks: passed\n");
+    if (testOnly) {
+        return 0;
+    }
+
+    printf("%-18s %8s %12s %12s\n", "backend", "bytes", "MB/s", "cycles/byte");
+    for (int b = 0; b < sha256_backend_count; ++b) {
+        sha256_select_backend(sha256_backends[b].name);
+
+        for (int path = 0; path < 2; ++path) {
+            for (int i = 0; i < numSizes; ++i) {
+                double cpb;
+                BenchResult *r = &results[numResults];
+
+                snprintf(labels[numResults], sizeof(labels[0]), "%s%s", sha256_backends[b].name,
+                         path ? "-stream" : "");
+                r->backend = labels[numResults++];
+                r->size = sizes[i];
+                r->mbps = bench_one(path ? hash_stream : hash_oneshot, sizes[i], minTime, &cpb);
+
+                if (HAVE_CYCLE_COUNTER) {
+                    printf("%-18s %8zu %12.2f %12.2f\n", r->backend, r->size, r->mbps, cpb);
+                } else {
+                    printf("%-18s %8zu %12.2f %12s\n", r->backend, r->size, r->mbps, "n/a");
+                }
+            }
+        }
+    }
+
+    if (savePath != NULL) {
+        FILE *fp = fopen(savePath, "w");
+        if (fp == NULL) {
+            perror("Failed to write the baseline");
+            return 2;
+        }
+        for (int i = 0; i < numResults; ++i) {
+            fprintf(fp, "%s %zu %.2f\n", results[i].backend, results[i].size, results[i].mbps);
+        }
+        fclose(fp);
+    }
+
+    if (baselinePath != NULL) {
+        BenchResult baseline[MAX_RESULTS];
+        char names[MAX_RESULTS][32];
+        int numBaseline = load_baseline(baselinePath, baseline, names);
+
+        if (numBaseline < 0) {
+            return 2;
+        }
+        for (int i = 0; i < numResults; ++i) {
+            for (int j = 0; j < numBaseline; ++j) {
+                if (strcmp(results[i].backend, baseline[j].backend) != 0 || results[i].size != baseline[j].size) {
+                    continue;
+                }
+                double change = (results[i].mbps - baseline[j].mbps) * 100.0 / baseline[j].mbps;
+                if (change < -maxRegression) {
+                    printf("REGRESSION %-10s %8zu: %.2f MB/s vs %.2f MB/s baseline (%.1f%%)\n",
+                           results[i].backend, results[i].size, results[i].mbps, baseline[j].mbps, change);
+                    regressions++;
+                }
+            }
+        }
+        printf("baseline check: %d regression(s) beyond %.1f%%\n", regressions, maxRegression);
+    }
+
+    return regressions ? 1 : 0;
+}
@@ -0,0 +1,4 @@
+#ifndef SHA256_BENCH_STUB_EXEC_MEMORY_H
+#define SHA256_BENCH_STUB_EXEC_MEMORY_H
+#include "../qemu-stubs.h"
+#endif
@@ -0,0 +1,4 @@
+#ifndef SHA256_BENCH_STUB_HW_HW_H
+#define SHA256_BENCH_STUB_HW_HW_H
+#include "../qemu-stubs.h"
+#endif
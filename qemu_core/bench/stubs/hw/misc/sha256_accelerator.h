@@ -0,0 +1,2 @@
+/* The device includes its header from the QEMU tree location, map it back to qemu_core/ */
+#include "../../../../sha256_accelerator.h"
@@ -0,0 +1,4 @@
+#ifndef SHA256_BENCH_STUB_QAPI_ERROR_H
+#define SHA256_BENCH_STUB_QAPI_ERROR_H
+#include "../qemu-stubs.h"
+#endif
@@ -0,0 +1,213 @@
+/**
+ ****************************************************************************************
+ * @file    qemu-stubs.c
+ * @brief   Host implementation of the small slice of QOM/qdev the device model needs:
+ *          type registration, property defaults, realize and MMIO region lookup.
+ ****************************************************************************************
+ */
+
+#include "qemu-stubs.h"
+
+#define MAX_TYPES   8
+#define MAX_DEVICES 8
+
+typedef struct {
+    const TypeInfo *info;
+    DeviceClass klass;
+    bool class_ready;
+} StubType;
+
+static StubType types[MAX_TYPES];
+static int numTypes;
+
+static struct {
+    SysBusDevice *dev;
+    MemoryRegion *mr;
+} regions[MAX_DEVICES];
+static int numRegions;
+
+void *type_register_static(const TypeInfo *info)
+{
+    if (numTypes < MAX_TYPES) {
+        types[numTypes++].info = info;
+    }
+    return NULL;
+}
+
+static StubType *find_type(const char *name)
+{
+    for (int i = 0; i < numTypes; ++i) {
+        if (strcmp(types[i].info->name, name) == 0) {
+            StubType *t = &types[i];
+            if (!t->class_ready) {
+                t->klass.parent_class.type = t->info;
+                if (t->info->class_init) {
+                    t->info->class_init(&t->klass.parent_class, NULL);
+                }
+                t->class_ready = true;
+            }
+            return t;
+        }
+    }
+    return NULL;
+}
+
+static void set_field(Object *obj, const Property *p, uint64_t value)
+{
+    uint8_t *field = (uint8_t *)obj + p->offset;
+
+    switch (p->size) {
+    case 1: *(uint8_t *)field = value; break;
+    case 2: *(uint16_t *)field = value; break;
+    case 4: *(uint32_t *)field = value; break;
+    default: *(uint64_t *)field = value; break;
+    }
+}
+
+Object *object_new(const char *typename)
+{
+    StubType *t = find_type(typename);
+    Object *obj;
+
+    if (t == NULL) {
+        fprintf(stderr, "object_new: unknown type %s\n", typename);
+        abort();
+    }
+
+    obj = calloc(1, t->info->instance_size);
+    obj->type = t->info;
+    for (Property *p = t->klass.props; p && p->name; ++p) {
+        set_field(obj, p, p->defval);
+    }
+    if (t->info->instance_init) {
+        t->info->instance_init(obj);
+    }
+    return obj;
+}
+
+bool object_property_set_uint(Object *obj, const char *name, uint64_t value, Error **errp)
+{
+    StubType *t = find_type(obj->type->name);
+
+    for (Property *p = t->klass.props; p && p->name; ++p) {
+        if (strcmp(p->name, name) == 0) {
+            set_field(obj, p, value);
+            return true;
+        }
+    }
+    error_setg(errp, "Property '%s.%s' not found", obj->type->name, name);
+    return false;
+}
+
+bool object_property_set_str(Object *obj, const char *name, const char *value, Error **errp)
+{
+    StubType *t = find_type(obj->type->name);
+
+    for (Property *p = t->klass.props; p && p->name; ++p) {
+        if (p->isString && strcmp(p->name, name) == 0) {
+            char **field = (char **)((uint8_t *)obj + p->offset);
+            free(*field);
+            *field = value ? strdup(value) : NULL;
+            return true;
+        }
+    }
+    error_setg(errp, "Property '%s.%s' not found", obj->type->name, name);
+    return false;
+}
+
+bool qdev_realize(DeviceState *dev, BusState *bus, Error **errp)
+{
+    StubType *t = find_type(dev->parent_obj.type->name);
+    Error *err = NULL;
+
+    (void)bus;
+    if (t->klass.realize) {
+        t->klass.realize(dev, &err);
+    }
+    if (err) {
+        if (errp) {
+            *errp = err;
+        } else {
+            error_free(err);
+        }
+        return false;
+    }
+    return true;
+}
+
+void object_unref(Object *obj)
+{
+    StubType *t = find_type(obj->type->name);
+
+    if (t->klass.unrealize) {
+        t->klass.unrealize(DEVICE(obj));
+    }
+    for (int i = 0; i < numRegions; ++i) {
+        if (regions[i].dev == (SysBusDevice *)obj) {
+            regions[i] = regions[--numRegions];
+            i--;
+        }
+    }
+    if (obj->type->instance_finalize) {
+        obj->type->instance_finalize(obj);
+    }
+    for (Property *p = t->klass.props; p && p->name; ++p) {
+        if (p->isString) {
+            free(*(char **)((uint8_t *)obj + p->offset));
+        }
+    }
+    free(obj);
+}
+
+void sysbus_init_mmio(SysBusDevice *dev, MemoryRegion *mr)
+{
+    if (numRegions < MAX_DEVICES) {
+        regions[numRegions].dev = dev;
+        regions[numRegions].mr = mr;
+        numRegions++;
+    }
+}
+
+MemoryRegion *sysbus_mmio_get_region(SysBusDevice *dev, int n)
+{
+    for (int i = 0; i < numRegions; ++i) {
+        if (regions[i].dev == dev && n-- == 0) {
+            return regions[i].mr;
+        }
+    }
+    return NULL;
+}
+
+static MemoryRegion *resolve_region(MemoryRegion *mr, hwaddr *addr)
+{
+    while (!mr->ops) {
+        MemoryRegion *next = NULL;
+
+        for (int i = 0; i < mr->numSubregions; ++i) {
+            if (*addr >= mr->subOffsets[i] && *addr < mr->subOffsets[i] + mr->subregions[i]->size) {
+                next = mr->subregions[i];
+                *addr -= mr->subOffsets[i];
+                break;
+            }
+        }
+        if (!next) {
+            return NULL;
+        }
+        mr = next;
+    }
+    return mr;
+}
+
+uint64_t stub_mmio_read(MemoryRegion *mr, hwaddr addr, unsigned size)
+{
+    mr = resolve_region(mr, &addr);
+    return mr ? mr->ops->read(mr->opaque, addr, size) : 0;
+}
+
+void stub_mmio_write(MemoryRegion *mr, hwaddr addr, uint64_t data, unsigned size)
+{
+    mr = resolve_region(mr, &addr);
+    if (mr) {
+        mr->ops->write(mr->opaque, addr, data, size);
+    }
+}
@@ -0,0 +1,316 @@
+/**
+ ****************************************************************************************
+ * @file    qemu-stubs.h
+ * @brief   Minimal stand-ins for the QEMU APIs used by sha256_accelerator.c, so that the
+ *          device model can be compiled and exercised on the host without a QEMU tree.
+ ****************************************************************************************
+ */
+
+#ifndef SHA256_BENCH_QEMU_STUBS_H
+#define SHA256_BENCH_QEMU_STUBS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+
+typedef uint64_t hwaddr;
+
+#define MAX_SUBREGIONS 64
+
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/* GLib ------------------------------------------------------------------------------ */
+
+#define g_malloc0(n)    calloc(1, (n))
+#define g_new0(T, n)    ((T *)calloc((n), sizeof(T)))
+#define g_free(p)       free(p)
+#define g_strdup(s)     strdup(s)
+
+/* Host utilities -------------------------------------------------------------------- */
+
+static inline uint64_t pow2ceil(uint64_t value)
+{
+    uint64_t n = 1;
+    while (n < value) {
+        n <<= 1;
+    }
+    return n;
+}
+
+static inline int clz64(uint64_t val) { return val ? __builtin_clzll(val) : 64; }
+
+/* Errors ---------------------------------------------------------------------------- */
+
+typedef struct Error {
+    char msg[256];
+} Error;
+
+#define error_setg(errp, ...) \
+    do { \
+        if (errp) { \
+            *(errp) = calloc(1, sizeof(Error)); \
+            snprintf((*(errp))->msg, sizeof((*(errp))->msg), __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define error_setg_errno(errp, err, fmt, ...) \
+    error_setg(errp, fmt ": %s", ##__VA_ARGS__, strerror(err))
+
+static inline const char *error_get_pretty(const Error *err) { return err->msg; }
+static inline void error_free(Error *err) { free(err); }
+
+/* QOM ------------------------------------------------------------------------------- */
+
+typedef struct TypeInfo TypeInfo;
+typedef struct ObjectClass ObjectClass;
+typedef struct DeviceClass DeviceClass;
+typedef struct DeviceState DeviceState;
+typedef struct BusState BusState;
+
+typedef struct Object {
+    const TypeInfo *type;
+} Object;
+
+struct DeviceState {
+    Object parent_obj;
+};
+
+typedef struct SysBusDevice {
+    DeviceState parent_obj;
+} SysBusDevice;
+
+typedef struct Property {
+    const char *name;
+    size_t offset;
+    size_t size;
+    uint64_t defval;
+    bool isString;                      // char * field owned by the object
+} Property;
+
+struct ObjectClass {
+    const TypeInfo *type;
+};
+
+struct DeviceClass {
+    ObjectClass parent_class;
+    void (*realize)(DeviceState *dev, Error **errp);
+    void (*unrealize)(DeviceState *dev);
+    Property *props;
+};
+
+struct TypeInfo {
+    const char *name;
+    const char *parent;
+    size_t instance_size;
+    void (*instance_init)(Object *obj);
+    void (*instance_finalize)(Object *obj);
+    void (*class_init)(ObjectClass *klass, void *data);
+};
+
+#define TYPE_SYS_BUS_DEVICE "sys-bus-device"
+
+#define DECLARE_INSTANCE_CHECKER(InstanceType, OBJ_NAME, TYPENAME) \
+    static inline InstanceType *OBJ_NAME(const void *obj) { return (InstanceType *)obj; }
+
+#define OBJECT(obj)         ((Object *)(obj))
+#define DEVICE(obj)         ((DeviceState *)(obj))
+#define SYS_BUS_DEVICE(obj) ((SysBusDevice *)(obj))
+#define DEVICE_CLASS(klass) ((DeviceClass *)(klass))
+
+static inline void device_class_set_props(DeviceClass *dc, Property *props) { dc->props = props; }
+
+#define DEFINE_PROP_UINT32(_name, _state, _field, _defval) \
+    { .name = (_name), .offset = offsetof(_state, _field), .size = sizeof(uint32_t), .defval = (_defval) }
+#define DEFINE_PROP_UINT64(_name, _state, _field, _defval) \
+    { .name = (_name), .offset = offsetof(_state, _field), .size = sizeof(uint64_t), .defval = (_defval) }
+#define DEFINE_PROP_STRING(_name, _state, _field) \
+    { .name = (_name), .offset = offsetof(_state, _field), .size = sizeof(char *), .isString = true }
+#define DEFINE_PROP_END_OF_LIST() { 0 }
+
+/* Host-side object lifecycle, implemented in qemu-stubs.c */
+void *type_register_static(const TypeInfo *info);
+Object *object_new(const char *typename);
+bool object_property_set_uint(Object *obj, const char *name, uint64_t value, Error **errp);
+bool object_property_set_str(Object *obj, const char *name, const char *value, Error **errp);
+bool qdev_realize(DeviceState *dev, BusState *bus, Error **errp);
+void object_unref(Object *obj);
+
+#define type_init(function) \
+    static void __attribute__((constructor)) stub_type_init_##function(void) { function(); }
+
+/* Memory API ------------------------------------------------------------------------ */
+
+enum device_endian {
+    DEVICE_NATIVE_ENDIAN,
+    DEVICE_BIG_ENDIAN,
+    DEVICE_LITTLE_ENDIAN,
+};
+
+typedef struct MemoryRegionOps {
+    uint64_t (*read)(void *opaque, hwaddr addr, unsigned size);
+    void (*write)(void *opaque, hwaddr addr, uint64_t data, unsigned size);
+    enum device_endian endianness;
+} MemoryRegionOps;
+
+typedef struct MemoryRegion {
+    const MemoryRegionOps *ops;
+    void *opaque;
+    const char *name;
+    uint64_t size;
+    bool globalLocking;                         // Cleared by memory_region_clear_global_locking()
+
+    /* Containers only: children in the order they were added */
+    struct MemoryRegion *subregions[MAX_SUBREGIONS];
+    hwaddr subOffsets[MAX_SUBREGIONS];
+    int numSubregions;
+} MemoryRegion;
+
+static inline void memory_region_init_io(MemoryRegion *mr, Object *owner, const MemoryRegionOps *ops,
+                                         void *opaque, const char *name, uint64_t size)
+{
+    (void)owner;
+    memset(mr, 0, sizeof(*mr));
+    mr->ops = ops;
+    mr->opaque = opaque;
+    mr->name = name;
+    mr->size = size;
+    mr->globalLocking = true;
+}
+
+static inline void memory_region_init(MemoryRegion *mr, Object *owner, const char *name, uint64_t size)
+{
+    memory_region_init_io(mr, owner, NULL, NULL, name, size);
+}
+
+static inline void memory_region_add_subregion(MemoryRegion *mr, hwaddr offset, MemoryRegion *sub)
+{
+    mr->subregions[mr->numSubregions] = sub;
+    mr->subOffsets[mr->numSubregions++] = offset;
+}
+
+static inline void memory_region_clear_global_locking(MemoryRegion *mr) { mr->globalLocking = false; }
+
+/* Dispatch an access through containers to the leaf region, like the flat view would */
+uint64_t stub_mmio_read(MemoryRegion *mr, hwaddr addr, unsigned size);
+void stub_mmio_write(MemoryRegion *mr, hwaddr addr, uint64_t data, unsigned size);
+
+/* Remembers the last region so host harnesses can drive the MMIO handlers */
+void sysbus_init_mmio(SysBusDevice *dev, MemoryRegion *mr);
+MemoryRegion *sysbus_mmio_get_region(SysBusDevice *dev, int n);
+
+/* Queues ---------------------------------------------------------------------------- */
+
+/* The subset of the QTAILQ macros of qemu/queue.h used by the device */
+#define QTAILQ_HEAD(name, type) \
+    struct name { struct type *tqh_first; struct type **tqh_last; }
+#define QTAILQ_HEAD_INITIALIZER(head) { NULL, &(head).tqh_first }
+#define QTAILQ_ENTRY(type) \
+    struct { struct type *tqe_next; struct type **tqe_prev; }
+
+#define QTAILQ_INSERT_TAIL(head, elm, field) \
+    do { \
+        (elm)->field.tqe_next = NULL; \
+        (elm)->field.tqe_prev = (head)->tqh_last; \
+        *(head)->tqh_last = (elm); \
+        (head)->tqh_last = &(elm)->field.tqe_next; \
+    } while (0)
+
+#define QTAILQ_REMOVE(head, elm, field) \
+    do { \
+        if ((elm)->field.tqe_next) { \
+            (elm)->field.tqe_next->field.tqe_prev = (elm)->field.tqe_prev; \
+        } else { \
+            (head)->tqh_last = (elm)->field.tqe_prev; \
+        } \
+        *(elm)->field.tqe_prev = (elm)->field.tqe_next; \
+    } while (0)
+
+#define QTAILQ_FOREACH(var, head, field) \
+    for ((var) = (head)->tqh_first; (var); (var) = (var)->field.tqe_next)
+
+/* Threads --------------------------------------------------------------------------- */
+
+typedef struct QemuThread { pthread_t thread; } QemuThread;
+typedef struct QemuMutex { pthread_mutex_t lock; } QemuMutex;
+typedef struct QemuCond { pthread_cond_t cond; } QemuCond;
+
+#define QEMU_THREAD_JOINABLE 0
+#define QEMU_THREAD_DETACHED 1
+
+static inline void qemu_thread_create(QemuThread *thread, const char *name, void *(*start_routine)(void *),
+                                      void *arg, int mode)
+{
+    (void)name;
+    pthread_create(&thread->thread, NULL, start_routine, arg);
+    if (mode == QEMU_THREAD_DETACHED) {
+        pthread_detach(thread->thread);
+    }
+}
+
+static inline void *qemu_thread_join(QemuThread *thread)
+{
+    void *ret;
+    pthread_join(thread->thread, &ret);
+    return ret;
+}
+
+static inline void qemu_mutex_init(QemuMutex *m) { pthread_mutex_init(&m->lock, NULL); }
+static inline void qemu_mutex_destroy(QemuMutex *m) { pthread_mutex_destroy(&m->lock); }
+static inline void qemu_mutex_lock(QemuMutex *m) { pthread_mutex_lock(&m->lock); }
+static inline void qemu_mutex_unlock(QemuMutex *m) { pthread_mutex_unlock(&m->lock); }
+
+static inline void qemu_cond_init(QemuCond *c) { pthread_cond_init(&c->cond, NULL); }
+static inline void qemu_cond_destroy(QemuCond *c) { pthread_cond_destroy(&c->cond); }
+static inline void qemu_cond_signal(QemuCond *c) { pthread_cond_signal(&c->cond); }
+static inline void qemu_cond_broadcast(QemuCond *c) { pthread_cond_broadcast(&c->cond); }
+static inline void qemu_cond_wait(QemuCond *c, QemuMutex *m) { pthread_cond_wait(&c->cond, &m->lock); }
+
+/* Clocks ---------------------------------------------------------------------------- */
+
+typedef enum { QEMU_CLOCK_REALTIME, QEMU_CLOCK_VIRTUAL, QEMU_CLOCK_HOST } QEMUClockType;
+
+static inline int64_t qemu_clock_get_ns(QEMUClockType type)
+{
+    struct timespec ts;
+
+    (void)type;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Bottom halves --------------------------------------------------------------------- */
+
+/* Without a main loop the callback runs straight away in the scheduling thread */
+typedef void QEMUBHFunc(void *opaque);
+typedef struct QEMUBH {
+    QEMUBHFunc *cb;
+    void *opaque;
+} QEMUBH;
+
+static inline QEMUBH *qemu_bh_new(QEMUBHFunc *cb, void *opaque)
+{
+    QEMUBH *bh = g_new0(QEMUBH, 1);
+    bh->cb = cb;
+    bh->opaque = opaque;
+    return bh;
+}
+
+static inline void qemu_bh_schedule(QEMUBH *bh) { bh->cb(bh->opaque); }
+static inline void qemu_bh_delete(QEMUBH *bh) { g_free(bh); }
+
+/* Logging --------------------------------------------------------------------------- */
+
+#define LOG_GUEST_ERROR (1 << 11)
+
+#define qemu_log_mask(mask, ...) \
+    do { if (getenv("SHA256_BENCH_LOG")) fprintf(stderr, __VA_ARGS__); } while (0)
+
+#endif
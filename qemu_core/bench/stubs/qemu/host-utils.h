@@ -0,0 +1,4 @@
+#ifndef SHA256_BENCH_STUB_QEMU_HOST_UTILS_H
+#define SHA256_BENCH_STUB_QEMU_HOST_UTILS_H
+#include "../qemu-stubs.h"
+#endif
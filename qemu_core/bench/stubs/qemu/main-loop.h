@@ -0,0 +1,4 @@
+#ifndef SHA256_BENCH_STUB_QEMU_MAIN_LOOP_H
+#define SHA256_BENCH_STUB_QEMU_MAIN_LOOP_H
+#include "../qemu-stubs.h"
+#endif
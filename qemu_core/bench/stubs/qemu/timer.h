@@ -0,0 +1,4 @@
+#ifndef SHA256_BENCH_STUB_QEMU_TIMER_H
+#define SHA256_BENCH_STUB_QEMU_TIMER_H
+#include "../qemu-stubs.h"
+#endif
@@ -0,0 +1,4 @@
+#ifndef SHA256_BENCH_STUB_QOM_OBJECT_H
+#define SHA256_BENCH_STUB_QOM_OBJECT_H
+#include "../qemu-stubs.h"
+#endif
@@ -13,6 +13,11 @@
 #include "hw/hw.h"
 #include "qapi/error.h"
 #include "qemu/log.h"
+#include "qemu/host-utils.h"
+#include "hw/qdev-properties.h"
+#include "qemu/thread.h"
+#include "qemu/main-loop.h"
+#include "qemu/timer.h"
 #include "hw/misc/sha256_accelerator.h"
 
 #include <stdio.h>
@@ -29,19 +34,72 @@ DECLARE_INSTANCE_CHECKER(SHA256DeviceState, SHA256_DEVICE, TYPE_SHA256_DEVICE)
 /* Device Register Mapping ----------------------------------------------------------- */
 
 #define ID_REG      0x0000          // Base register to hold device identification information
-#define INIT_REG    0x0004			
+#define CAP_REG     0x0004          // Read-only capability register, holds the input window size in bytes
 #define CTRL_REG    0x0008          // Control operation of the core, such as starting computation or resetting the core
 #define STATUS_REG  0x000C          // Status information regarding the core, such as whether it is idle or busy 
-#define INPUT_REG   0x0010          // Store the input string from the user to be encrypted (1KB input buffer)
-#define OUTPUT_REG  0x0410          // Retrieve the output string containing the final SHA256 digest from the core
+#define INPUT_REG   0x0010          // Store the input string from the user to be encrypted (input-size bytes, 1KB default)
+
+/* The output register directly follows the input window, 0x0410 with the default 1KB window */
+#define OUTPUT_REG(s)   (INPUT_REG + (s)->inputSize)
+
+/* Extended registers follow the output register, 0x0430 with the default 1KB window */
+#define EXT_REG(s)      (OUTPUT_REG(s) + outputBufferSize)
+#define LEN_REG(s)      (EXT_REG(s) + 0x00)     // Message bytes held in the selected bank (strnlen if never written)
+#define IRQ_REG(s)      (EXT_REG(s) + 0x04)     // Interrupt enable, irqDONE raises the context's vector per completed job
+#define QUEUES_REG(s)   (EXT_REG(s) + 0x08)     // Read-only, number of contexts (queues) of the device
+
+/*
+ * Key derivation parameters, latched when a bank is started with a KDF operation. The bank
+ * holds key || salt || info and the derived key is written back over the start of the bank,
+ * its first 32 bytes are also placed in the output register.
+ */
+#define KDF_ITER_REG(s)     (EXT_REG(s) + 0x0C)     // PBKDF2 iteration count, times the output blocks at most pbkdf2MaxWork
+#define KDF_KEYLEN_REG(s)   (EXT_REG(s) + 0x10)     // Password (PBKDF2), input key (HKDF) or PRK (HKDF expand) bytes
+#define KDF_SALTLEN_REG(s)  (EXT_REG(s) + 0x14)     // Salt bytes following the key
+#define KDF_INFOLEN_REG(s)  (EXT_REG(s) + 0x18)     // HKDF info bytes following the salt
+#define KDF_OUTLEN_REG(s)   (EXT_REG(s) + 0x1C)     // Derived key bytes, at most the window size
+
+/*
+ * Content-defined chunking parameters, latched when a bank is started with opCDC. The
+ * stream goes over the banks as for opHASH and every part is replaced by the records of
+ * the chunks that end in it, see sha256_cdc_update().
+ */
+#define CDC_MIN_REG(s)      (EXT_REG(s) + 0x20)     // Smallest chunk, no cut point is looked for below it
+#define CDC_AVG_REG(s)      (EXT_REG(s) + 0x24)     // Target chunk size
+#define CDC_MAX_REG(s)      (EXT_REG(s) + 0x28)     // Largest chunk, cut unconditionally
+#define CDC_COUNT_REG(s)    (EXT_REG(s) + 0x2C)     // Read-only, records in the bank mapped into the window
 
 /* Device Macros Definitions --------------------------------------------------------- */
 
-#define deviceEN            0x00000001      // Bitmask to enable the core
+#define deviceEN            0x00000001      // Bitmask to enable the core (start hashing the bank in deviceBANK)
 #define deviceRST			0x00000000		// Bitmask to reset the core
+#define deviceBANK          0x00000002      // Bank select bit used by deviceEN and deviceSELECT
+#define deviceMORE          0x00000004      // Bank is not the last part of the message, keep the running hash
+#define deviceSELECT        0x00000008      // Map the bank in deviceBANK into the input window and LEN_REG
+#define CTRL_BANK(ctrl)     (((ctrl) & deviceBANK) ? 1 : 0)
+#define CTRL_OP(ctrl)       (((ctrl) >> 4) & 0xF)   // Operation run by deviceEN, bits 7:4
+
+#define opHASH              0x0             // SHA-256 of the message streamed over the banks
+#define opPBKDF2            0x1             // PBKDF2-HMAC-SHA256 (RFC 8018)
+#define opHKDF              0x2             // HKDF-SHA256 extract and expand (RFC 5869)
+#define opHKDFEXPAND        0x3             // HKDF-SHA256 expand only, the key is the PRK
+#define opCDC               0x4             // FastCDC chunking with a SHA-256 per chunk
+#define hkdfMaxOutput       (255 * outputBufferSize)    // Longest HKDF output, 255 blocks
+#define pbkdf2MaxWork       (1u << 20)      // Longest PBKDF2 job, iterations times 32-byte output blocks
+
+#define statusDONE(bank)    (0x1 << ((bank) * 4))   // Bank was hashed, for a final part the digest is ready
+#define statusBUSY(bank)    (0x2 << ((bank) * 4))   // Bank is queued or being hashed, its window is read-only
+
+#define irqDONE             0x00000001      // Interrupt when a started bank has been hashed
+
+#define numBanks            SHA256_NUM_BANKS    // Ping-pong input banks
 #define DEVICE_ID			0xFEEDCAFE     	// Harcoded ID information for the accelerator core
-#define inputBufferSize     1024            // 1024 bytes for input size
-#define outputBufferSize    32              // 32 byte (256 bits) buffer for final digest 
+#define inputBufferSize     1024            // Default input window size in bytes
+#define maxInputBufferSize  0x10000         // Largest input window the device can be configured with (64KB)
+#define minMmioSize         0x1000          // Smallest MMIO region, also the one used by the default window
+#define maxContexts         64              // Register pages (contexts) of one device
+#define extRegBlockSize     0x40            // Space reserved for the extended registers
+#define outputBufferSize    SHA256_DIGEST_SIZE  // 32 byte (256 bits) buffer for final digest
 #define CHUNK_SIZE          64              // Size of each chunk in words (512 bits)
 
 #define RIGHT_ROTATE(value, n) (((value) >> (n)) | ((value) << (32 - (n))))
@@ -50,10 +108,7 @@ DECLARE_INSTANCE_CHECKER(SHA256DeviceState, SHA256_DEVICE, TYPE_SHA256_DEVICE)
 
 uint8_t digest[outputBufferSize];			// Array to store final digest (8 hash values * 4 bytes/hash = 32 bytes digest)
 
-int perform_sha256_hashing(char *inputStr) {
-    
-    /* Determine the size of the input string */
-    size_t inStrSize = strlen(inputStr);
+int perform_sha256_hashing(char *inputStr, size_t inStrSize) {
 
 	unsigned char* messageBlock;
 	int numBlocks;			
@@ -61,7 +116,6 @@ int perform_sha256_hashing(char *inputStr) {
 	int numChunks;
 	unsigned char** chunks;
 	int chunkIndex = 0;
-	uint32_t w[64];					// Message schedule array
 
 	/* Initilizaing hash values */
     uint32_t hashVal[8] = {
@@ -122,10 +176,9 @@ int perform_sha256_hashing(char *inputStr) {
 		}
 	}
 
-	/* Create the message schedule performing compression for each chunk */
+	/* Run the active compression backend over each chunk */
 	for(chunkIndex = 0; chunkIndex < numChunks; ++chunkIndex){
-		messageSchedule(chunkIndex, chunks, numChunks, w);	// Generate message schedule for current chunk
-		compression(hashVal, w); 							// Perform compression using the current chunk
+		sha256_active_backend->process_block(hashVal, chunks[chunkIndex]);
 	}
 
 	/* Append the hash values to the digest array */
@@ -153,7 +206,7 @@ void encodeMessageBlock(char* inStr, unsigned char messageBlock[], const int inS
 	int binaryDigit = 0;
 	int ascii = 0;
 
-	for(int i = 0; inStr[i] != '\0'; ++i) {
+	for(int i = 0; i < inSize; ++i) {
 		ascii = inStr[i];
 		for (int j = 7; j >= 0; --j) {
 			binaryDigit = (ascii >> j) & 1;
@@ -262,37 +315,854 @@ void compression(uint32_t hashVal[], uint32_t w[]) {
 
 }
 
-/* Device Modelling with QOM ------------------- ------------------------------------- */
+/* Compression Backends -------------------------------------------------------------- */
+
+static const uint32_t roundConstants[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b,
+	0x59f111f1, 0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01,
+	0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7,
+	0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152,
+	0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+	0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+	0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819,
+	0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116, 0x1e376c08,
+	0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f,
+	0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
 
-struct SHA256DeviceState {
-    SysBusDevice parent_obj;
-    MemoryRegion iomem;    						// Memory region for device I/O
-    char inputBuffer[inputBufferSize];   	    // Buffer to store input data
-    uint8_t outputBuffer[outputBufferSize]; 	// Buffer to store output SHA256 hash
-    uint32_t control;      						// Control register to start/stop and manage the device
-    uint32_t status;       						// Status register to indicate device state (e.g., busy, ready)
+/* Reference backend: the original two-pass schedule + compression functions */
+static void reference_process_block(uint32_t hashVal[], const uint8_t *block) {
+
+	unsigned char *chunk = (unsigned char *)block;
+	uint32_t w[64];
+
+	messageSchedule(0, &chunk, 1, w);
+	compression(hashVal, w);
+}
+
+/* Fused backend: expands the schedule on the fly in a 16 word window, no 64 word array */
+#define SHA_LOAD_BE32(p)	(((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | \
+							 ((uint32_t)(p)[2] << 8) | (uint32_t)(p)[3])
+#define SHA_SIGMA0(x)		(RIGHT_ROTATE(x, 7) ^ RIGHT_ROTATE(x, 18) ^ ((x) >> 3))
+#define SHA_SIGMA1(x)		(RIGHT_ROTATE(x, 17) ^ RIGHT_ROTATE(x, 19) ^ ((x) >> 10))
+#define SHA_SUM0(x)			(RIGHT_ROTATE(x, 2) ^ RIGHT_ROTATE(x, 13) ^ RIGHT_ROTATE(x, 22))
+#define SHA_SUM1(x)			(RIGHT_ROTATE(x, 6) ^ RIGHT_ROTATE(x, 11) ^ RIGHT_ROTATE(x, 25))
+#define SHA_CH(e, f, g)		(((e) & (f)) ^ (~(e) & (g)))
+#define SHA_MAJ(a, b, c)	(((a) & (b)) ^ ((a) & (c)) ^ ((b) & (c)))
+
+static void fused_process_block(uint32_t hashVal[], const uint8_t *block) {
+
+	uint32_t w[16];
+	uint32_t a = hashVal[0], b = hashVal[1], c = hashVal[2], d = hashVal[3];
+	uint32_t e = hashVal[4], f = hashVal[5], g = hashVal[6], h = hashVal[7];
+	uint32_t temp1, temp2;
+
+	for (int i = 0; i < 64; ++i) {
+		if (i < 16) {
+			w[i] = SHA_LOAD_BE32(block + i * 4);
+		} else {
+			w[i & 15] += SHA_SIGMA0(w[(i + 1) & 15]) + w[(i + 9) & 15] + SHA_SIGMA1(w[(i + 14) & 15]);
+		}
+
+		temp1 = h + SHA_SUM1(e) + SHA_CH(e, f, g) + roundConstants[i] + w[i & 15];
+		temp2 = SHA_SUM0(a) + SHA_MAJ(a, b, c);
+
+		h = g;
+		g = f;
+		f = e;
+		e = d + temp1;
+		d = c;
+		c = b;
+		b = a;
+		a = temp1 + temp2;
+	}
+
+	hashVal[0] += a;
+	hashVal[1] += b;
+	hashVal[2] += c;
+	hashVal[3] += d;
+	hashVal[4] += e;
+	hashVal[5] += f;
+	hashVal[6] += g;
+	hashVal[7] += h;
+}
+
+const SHA256Backend sha256_backends[] = {
+	{ "reference", reference_process_block },
+	{ "fused", fused_process_block },
 };
+const int sha256_backend_count = sizeof(sha256_backends) / sizeof(sha256_backends[0]);
 
-static uint64_t sha_device_read(void *opaque, hwaddr addr, unsigned int size)
+const SHA256Backend *sha256_active_backend = &sha256_backends[0];
+
+/* Select the backend used by perform_sha256_hashing(), returns false for unknown names */
+bool sha256_select_backend(const char *name) {
+
+	for (int i = 0; i < sha256_backend_count; ++i) {
+		if (strcmp(sha256_backends[i].name, name) == 0) {
+			sha256_active_backend = &sha256_backends[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Streaming Interface --------------------------------------------------------------- */
+
+/* Unlike perform_sha256_hashing(), the context absorbs a message in arbitrary pieces */
+
+void sha256_init(SHA256Context *ctx) {
+
+	static const uint32_t initialHashVal[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+
+	memcpy(ctx->hashVal, initialHashVal, sizeof(initialHashVal));
+	ctx->blockLen = 0;
+	ctx->totalLen = 0;
+}
+
+void sha256_update(SHA256Context *ctx, const uint8_t *data, size_t len) {
+
+	ctx->totalLen += len;
+
+	/* Top up a partially filled block first */
+	if (ctx->blockLen > 0) {
+		size_t n = MIN(len, CHUNK_SIZE - ctx->blockLen);
+		memcpy(ctx->block + ctx->blockLen, data, n);
+		ctx->blockLen += n;
+		data += n;
+		len -= n;
+		if (ctx->blockLen < CHUNK_SIZE) {
+			return;
+		}
+		sha256_active_backend->process_block(ctx->hashVal, ctx->block);
+		ctx->blockLen = 0;
+	}
+
+	/* Whole blocks are compressed straight from the caller's buffer */
+	while (len >= CHUNK_SIZE) {
+		sha256_active_backend->process_block(ctx->hashVal, data);
+		data += CHUNK_SIZE;
+		len -= CHUNK_SIZE;
+	}
+
+	memcpy(ctx->block, data, len);
+	ctx->blockLen = len;
+}
+
+void sha256_final(SHA256Context *ctx, uint8_t out[]) {
+
+	uint64_t length = ctx->totalLen * 8;		// Message length in bits
+
+	/* Append the single 1 bit, then zeros up to the 64-bit big endian length */
+	ctx->block[ctx->blockLen++] = 0x80;
+	if (ctx->blockLen > CHUNK_SIZE - 8) {
+		memset(ctx->block + ctx->blockLen, 0, CHUNK_SIZE - ctx->blockLen);
+		sha256_active_backend->process_block(ctx->hashVal, ctx->block);
+		ctx->blockLen = 0;
+	}
+	memset(ctx->block + ctx->blockLen, 0, CHUNK_SIZE - 8 - ctx->blockLen);
+	for (int i = 0; i < 8; ++i) {
+		ctx->block[CHUNK_SIZE - 8 + i] = (length >> ((7 - i) * 8)) & 0xFF;
+	}
+	sha256_active_backend->process_block(ctx->hashVal, ctx->block);
+
+	for (int i = 0; i < 8; ++i) {
+		out[i * 4] = (ctx->hashVal[i] >> 24) & 0xFF;
+		out[i * 4 + 1] = (ctx->hashVal[i] >> 16) & 0xFF;
+		out[i * 4 + 2] = (ctx->hashVal[i] >> 8) & 0xFF;
+		out[i * 4 + 3] = ctx->hashVal[i] & 0xFF;
+	}
+}
+
+/* Key Derivation -------------------------------------------------------------------- */
+
+/* HMAC-SHA256 key, the states after absorbing the ipad and opad blocks */
+typedef struct {
+	SHA256Context inner;
+	SHA256Context outer;
+} SHA256HmacKey;
+
+static void sha_store_hash(const uint32_t hashVal[], uint8_t out[]) {
+
+	for (int i = 0; i < 8; ++i) {
+		out[i * 4] = (hashVal[i] >> 24) & 0xFF;
+		out[i * 4 + 1] = (hashVal[i] >> 16) & 0xFF;
+		out[i * 4 + 2] = (hashVal[i] >> 8) & 0xFF;
+		out[i * 4 + 3] = hashVal[i] & 0xFF;
+	}
+}
+
+static void sha_hmac_init(SHA256HmacKey *k, const uint8_t *key, size_t keyLen) {
+
+	uint8_t block[CHUNK_SIZE] = { 0 };
+	uint8_t pad[CHUNK_SIZE];
+
+	/* Keys longer than a block are replaced by their digest */
+	if (keyLen > CHUNK_SIZE) {
+		sha256_init(&k->inner);
+		sha256_update(&k->inner, key, keyLen);
+		sha256_final(&k->inner, block);
+	} else {
+		memcpy(block, key, keyLen);
+	}
+
+	for (int i = 0; i < CHUNK_SIZE; ++i) {
+		pad[i] = block[i] ^ 0x36;
+	}
+	sha256_init(&k->inner);
+	sha256_update(&k->inner, pad, CHUNK_SIZE);
+
+	for (int i = 0; i < CHUNK_SIZE; ++i) {
+		pad[i] = block[i] ^ 0x5c;
+	}
+	sha256_init(&k->outer);
+	sha256_update(&k->outer, pad, CHUNK_SIZE);
+}
+
+/* Completes an HMAC whose message was absorbed into ctx, a copy of the inner state */
+static void sha_hmac_final(const SHA256HmacKey *k, SHA256Context *ctx, uint8_t out[]) {
+
+	uint8_t inner[outputBufferSize];
+
+	sha256_final(ctx, inner);
+	*ctx = k->outer;
+	sha256_update(ctx, inner, outputBufferSize);
+	sha256_final(ctx, out);
+}
+
+/*
+ * HMAC of the 32 byte message in block[0..31], written back in place. The rest of the
+ * block holds the constant padding, so each state costs exactly one compression.
+ */
+static void sha_hmac_block(const SHA256HmacKey *k, uint8_t block[]) {
+
+	uint32_t hashVal[8];
+
+	memcpy(hashVal, k->inner.hashVal, sizeof(hashVal));
+	sha256_active_backend->process_block(hashVal, block);
+	sha_store_hash(hashVal, block);
+
+	memcpy(hashVal, k->outer.hashVal, sizeof(hashVal));
+	sha256_active_backend->process_block(hashVal, block);
+	sha_store_hash(hashVal, block);
+}
+
+/**
+ * @brief PBKDF2-HMAC-SHA256 (RFC 8018). The iterated HMAC chain starts from the ipad and
+ * opad midstates, two compressions per iteration.
+ *
+ * @param iterations Iteration count, at least 1.
+ * @param out Receives outLen bytes of derived key.
+ */
+
+void sha256_pbkdf2(const uint8_t *password, size_t passwordLen, const uint8_t *salt, size_t saltLen,
+                   uint32_t iterations, uint8_t *out, size_t outLen) {
+
+	SHA256HmacKey key;
+	SHA256Context ctx;
+	uint8_t block[CHUNK_SIZE] = { 0 };
+	uint8_t t[outputBufferSize];
+
+	sha_hmac_init(&key, password, passwordLen);
+	block[outputBufferSize] = 0x80;
+	block[CHUNK_SIZE - 2] = 0x03;					// (64 + 32) * 8 message bits, ipad block included
+
+	for (uint32_t i = 1; outLen > 0; ++i) {
+		uint8_t index[4] = { i >> 24, i >> 16, i >> 8, i };
+		size_t n = MIN(outLen, outputBufferSize);
+
+		ctx = key.inner;
+		sha256_update(&ctx, salt, saltLen);
+		sha256_update(&ctx, index, sizeof(index));
+		sha_hmac_final(&key, &ctx, block);			// U1
+		memcpy(t, block, outputBufferSize);
+
+		for (uint32_t j = 1; j < iterations; ++j) {
+			sha_hmac_block(&key, block);
+			for (int b = 0; b < outputBufferSize; ++b) {
+				t[b] ^= block[b];
+			}
+		}
+
+		memcpy(out, t, n);
+		out += n;
+		outLen -= n;
+	}
+}
+
+/**
+ * @brief HKDF-SHA256 (RFC 5869).
+ *
+ * @param key Input key material, or the PRK when extract is false.
+ * @param salt Extract salt, an empty salt is the all-zero key of the RFC.
+ * @param extract Run the extract step before expanding.
+ * @param out Receives outLen bytes of output key material, at most 255 * 32.
+ */
+
+void sha256_hkdf(const uint8_t *key, size_t keyLen, const uint8_t *salt, size_t saltLen,
+                 const uint8_t *info, size_t infoLen, bool extract, uint8_t *out, size_t outLen) {
+
+	SHA256HmacKey hmac;
+	SHA256Context ctx;
+	uint8_t prk[outputBufferSize];
+	uint8_t t[outputBufferSize];
+
+	if (extract) {
+		sha_hmac_init(&hmac, salt, saltLen);
+		ctx = hmac.inner;
+		sha256_update(&ctx, key, keyLen);
+		sha_hmac_final(&hmac, &ctx, prk);
+		sha_hmac_init(&hmac, prk, outputBufferSize);
+	} else {
+		sha_hmac_init(&hmac, key, keyLen);
+	}
+
+	/* T(i) = HMAC(PRK, T(i - 1) || info || i), T(0) is empty */
+	for (uint8_t i = 1; outLen > 0; ++i) {
+		size_t n = MIN(outLen, outputBufferSize);
+
+		ctx = hmac.inner;
+		if (i > 1) {
+			sha256_update(&ctx, t, outputBufferSize);
+		}
+		sha256_update(&ctx, info, infoLen);
+		sha256_update(&ctx, &i, 1);
+		sha_hmac_final(&hmac, &ctx, t);
+
+		memcpy(out, t, n);
+		out += n;
+		outLen -= n;
+	}
+}
+
+/* Content-Defined Chunking ---------------------------------------------------------- */
+
+/* Gear hash table, splitmix64 outputs from seed 0 so guest software can reproduce the cuts */
+static const uint64_t cdcGear[256] = {
+	0xe220a8397b1dcdafULL, 0x6e789e6aa1b965f4ULL, 0x06c45d188009454fULL, 0xf88bb8a8724c81ecULL,
+	0x1b39896a51a8749bULL, 0x53cb9f0c747ea2eaULL, 0x2c829abe1f4532e1ULL, 0xc584133ac916ab3cULL,
+	0x3ee5789041c98ac3ULL, 0xf3b8488c368cb0a6ULL, 0x657eecdd3cb13d09ULL, 0xc2d326e0055bdef6ULL,
+	0x8621a03fe0bbdb7bULL, 0x8e1f7555983aa92fULL, 0xb54e0f1600cc4d19ULL, 0x84bb3f97971d80abULL,
+	0x7d29825c75521255ULL, 0xc3cf17102b7f7f86ULL, 0x3466e9a083914f64ULL, 0xd81a8d2b5a4485acULL,
+	0xdb01602b100b9ed7ULL, 0xa9038a921825f10dULL, 0xedf5f1d90dca2f6aULL, 0x54496ad67bd2634cULL,
+	0xdd7c01d4f5407269ULL, 0x935e82f1db4c4f7bULL, 0x69b82ebc92233300ULL, 0x40d29eb57de1d510ULL,
+	0xa2f09dabb45c6316ULL, 0xee521d7a0f4d3872ULL, 0xf16952ee72f3454fULL, 0x377d35dea8e40225ULL,
+	0x0c7de8064963bab0ULL, 0x05582d37111ac529ULL, 0xd254741f599dc6f7ULL, 0x69630f7593d108c3ULL,
+	0x417ef96181daa383ULL, 0x3c3c41a3b43343a1ULL, 0x6e19905dcbe531dfULL, 0x4fa9fa7324851729ULL,
+	0x84eb4454a792922aULL, 0x134f7096918175ceULL, 0x07dc930b302278a8ULL, 0x12c015a97019e937ULL,
+	0xcc06c31652ebf438ULL, 0xecee65630a691e37ULL, 0x3e84ecb1763e79adULL, 0x690ed476743aae49ULL,
+	0x774615d7b1a1f2e1ULL, 0x22b353f04f4f52daULL, 0xe3ddd86ba71a5eb1ULL, 0xdf268adeb6513356ULL,
+	0x2098eb73d4367d77ULL, 0x03d6845323ce3c71ULL, 0xc952c5620043c714ULL, 0x9b196bca844f1705ULL,
+	0x30260345dd9e0ec1ULL, 0xcf448a5882bb9698ULL, 0xf4a578dccbc87656ULL, 0xbfdeaed9a17b3c8fULL,
+	0xed79402d1d5c5d7bULL, 0x55f070ab1cbbf170ULL, 0x3e00a34929a88f1dULL, 0xe255b237b8bb18fbULL,
+	0x2a7b67af6c6ad50eULL, 0x466d5e7f3e46f143ULL, 0x42375cb399a4fc72ULL, 0x8c8a1f148a8bb259ULL,
+	0x32fcab5daed5bdfcULL, 0x9e60398c8d8553c0ULL, 0xee89cceb8c4064c0ULL, 0xdb0215941d86a66fULL,
+	0x5ccde78203c367a8ULL, 0xf1bcbc6a1ec11786ULL, 0xef054fceee954551ULL, 0xdf82012d0555c6dfULL,
+	0x292566ff72403c08ULL, 0xc4dd302a1bfa1137ULL, 0xd85f219db5c554e1ULL, 0x6a27ff807441bcd2ULL,
+	0x96a573e9b48216e8ULL, 0x46a9fdac40bf0048ULL, 0x3dd12464a0ee15b4ULL, 0x451e521296a7eea1ULL,
+	0x56e4398a98f8a0fdULL, 0x7b7dc2160e3335a7ULL, 0xc679ee0bebcb1ccaULL, 0x928d6f2d7453424eULL,
+	0x1b38994205234c6dULL, 0x8086d193a6f2b568ULL, 0x21c6e26639ac2c65ULL, 0xd9dccac414d23c6fULL,
+	0x91cd642057e00235ULL, 0x77fc607dc6589373ULL, 0x05b8abe26dd3aee7ULL, 0x12f6436ac376cc66ULL,
+	0x64952424897b2307ULL, 0xee8c2baf6343e5c3ULL, 0xdc4c613d9eba2304ULL, 0x3505b7796bd1a506ULL,
+	0x8176daf800a05f50ULL, 0x8bd8ff7a0385cdbcULL, 0x1a764a3cd78101daULL, 0xbe4d15bf6ca266acULL,
+	0xa85e1f38bb2dc749ULL, 0x56759a968493cd8cULL, 0xf3a9bce7336bd182ULL, 0x365b15013741519bULL,
+	0x1f7a44a6b109ac94ULL, 0x3521d628813cb177ULL, 0x6a77afab0f7c9370ULL, 0x179642d8cde95015ULL,
+	0x5ef102a8fb354461ULL, 0xf51c504764ed82f2ULL, 0xc58427f041ce6808ULL, 0xfad8fc45c9643c37ULL,
+	0xcf8682f9a70fa9c0ULL, 0x7e1b3b75a4005729ULL, 0x992dd867927b52d8ULL, 0x7fbd5db142f6791fULL,
+	0x370595aacab4adaeULL, 0xb1392dbdc5ab61d6ULL, 0x9fea7dfc79d452d9ULL, 0x40b12b120085641cULL,
+	0xa192afe3157c85d0ULL, 0xc847729f4e08f3a3ULL, 0x6f1384a306c41fc2ULL, 0x12d05c4045a39c19ULL,
+	0x9899202fd20f0841ULL, 0xe9c7191857e774b8ULL, 0x4eead809af5b0cc3ULL, 0xe809acafa23864a4ULL,
+	0x4da1edaba1d0f7bdULL, 0x846eb9673349f8e4ULL, 0x87bae55b86039fe8ULL, 0x7f367b8bd953eff2ULL,
+	0x3884700f650d04e1ULL, 0xbfe4b2ab46980cadULL, 0xc5fc89075299106cULL, 0x37b2fa361adea7cdULL,
+	0x7d75d813f04895b4ULL, 0x702f5b393f62c0e0ULL, 0x0a3fc775f4ecf37fULL, 0xe4b23787a352437fULL,
+	0xf83fa245c34d6363ULL, 0xb99bcf040786cf50ULL, 0x38b6ea0a0e6c9d8aULL, 0x093fdc76776e37e1ULL,
+	0x1a75e6f76ba7eee8ULL, 0x442cdcfee9660c62ULL, 0x22d58d35116b5e0bULL, 0x87d4a5180f6a3645ULL,
+	0x589fb216bd82131bULL, 0x91d031cad319aec0ULL, 0xabecf76a553d320bULL, 0xb8686cb347612dcfULL,
+	0xfcab66337c0a77f5ULL, 0xac318214381ec437ULL, 0x6eb7f0fca24494aeULL, 0xcf42861dcdc895a9ULL,
+	0x4abad7a1586d7a91ULL, 0xc21b318dc2f49745ULL, 0xd49474dc2acbd1f0ULL, 0xb1d4873747c1c8e1ULL,
+	0x5434dc8c7d015bf6ULL, 0xe1c486287511b6a9ULL, 0xa8616df62e89a193ULL, 0x31ce6319498d8347ULL,
+	0xafd0b486123d6faaULL, 0xe6495f5d102301ebULL, 0x0dc51ced17a43c52ULL, 0x8bcbcde81355ef2dULL,
+	0x2412af73fdee7cfcULL, 0xc8d589e486e29eedULL, 0x23390e8664517f89ULL, 0x251ade58e8a6849dULL,
+	0xf8555dbd2e8f9cb0ULL, 0xcb417c3eef54f7c3ULL, 0x8028f8e1aac3a919ULL, 0x10e31052acf748a0ULL,
+	0x2d886c073b1e1b78ULL, 0x972974d90df9faeeULL, 0xbc1b7b38796893baULL, 0x1958ed432070e652ULL,
+	0xca5f297197a12dccULL, 0xe025a27375704f28ULL, 0x418010a570a924fbULL, 0x9828e2941bfc419cULL,
+	0x4fbacd2f52b85c1fULL, 0x33dd5b756211cc67ULL, 0x23c8dfdd1db57ff0ULL, 0x32f81801a1a8e901ULL,
+	0x26884eac5ada36daULL, 0xcaa82f9bb42e37d4ULL, 0x19fb1a7491d6a7d1ULL, 0x5aa0243aa357f38eULL,
+	0xb31d917809e447f0ULL, 0x3f9c197225215be0ULL, 0xdc3c315a1e33c095ULL, 0x3dd399ad533e80acULL,
+	0x566f32cce8301d95ULL, 0xc880188083d9ba21ULL, 0xb9cc357f3b0e7d2eULL, 0x0237d2123a8a8d6cULL,
+	0xbf636e9aa7cbf6bdULL, 0xd7bd4284c4e2a6a7ULL, 0xda2ebb47d50577a9ULL, 0x90ba1c11b539087dULL,
+	0x44993d31552b4f57ULL, 0x32c2d6f80a8a8898ULL, 0x450583ed7fb54b19ULL, 0xec2b0b09e50ef3efULL,
+	0xd918a0b6e2efd65cULL, 0xe37a868d9785f572ULL, 0x7d1a6118f2b0f37aULL, 0x9e2e3cc13b343439ULL,
+	0xefd82c11212e37e8ULL, 0xaf89c05cd4fc75edULL, 0x55bc16bb9697108eULL, 0x6c4701fa5db69beeULL,
+	0x9237338441daf445ULL, 0x248cf0831e81a5fcULL, 0xacc13557e77de273ULL, 0x520970c25e06513aULL,
+	0x657329cb02987cabULL, 0xa9b0b3366a4e55a8ULL, 0xc4d06ca2f39acdd4ULL, 0x5dce37d68170cde1ULL,
+	0x5f1e44e77e1854c9ULL, 0x6883d452d55df899ULL, 0x05c5bd62f1067032ULL, 0xe680b683ce60fab0ULL,
+	0x5dc9da3f286d18b1ULL, 0x94b4bf3ab85ed6d8ULL, 0xce65f449e3acc5a3ULL, 0x34b0209642cea639ULL,
+	0xc14c3c771d904827ULL, 0x6addcee2bd9cdee5ULL, 0xe24eed137ffbb613ULL, 0x75dd58ef79963d1bULL,
+	0xfdb83ecf6cc24920ULL, 0x7a1d0057c57169fbULL, 0x339200f4feb62d07ULL, 0xd33f4d4ac88469f4ULL,
+	0x8226f234e68dfee4ULL, 0x320def4f2a105536ULL, 0x7786f3b13aefc159ULL, 0xb28225ac9df63ee2ULL,
+	0x781b9d0376cc6044ULL, 0x05bd0115226c6ab6ULL, 0xd302230207bdfdabULL, 0xdb898abd8e0d2933ULL,
+	0x9e79a397ba00b9ccULL, 0x89df84a5f0003ee8ULL, 0x011f04f2a75fb9beULL, 0x5a5832bb47bcf19eULL,
+};
+
+static void sha_store_le(uint8_t *p, uint64_t value, int bytes) {
+	for (int i = 0; i < bytes; ++i) {
+		p[i] = value >> (i * 8);
+	}
+}
+
+void sha256_cdc_init(SHA256CdcState *st) {
+	sha256_init(&st->hash);
+	st->fingerprint = 0;
+	st->offset = 0;
+	st->length = 0;
+}
+
+/* Closes the chunk in progress into a record and starts the next one at the following byte */
+static void sha_cdc_emit(SHA256CdcState *st, uint8_t *record) {
+
+	memset(record, 0, SHA256_CDC_RECORD_SIZE);
+	sha_store_le(record, st->offset, 8);
+	sha_store_le(record + 8, st->length, 4);
+	sha256_final(&st->hash, record + 16);
+
+	st->offset += st->length;
+	sha256_init(&st->hash);
+	st->fingerprint = 0;
+	st->length = 0;
+}
+
+/**
+ * @brief FastCDC content-defined chunking with normalized chunking level 2. No cut point is
+ * looked for in the first minSize bytes of a chunk. After that the gear hash
+ * fp = (fp << 1) + gear[byte] cuts after the byte that leaves the top log2(avgSize) + 2 bits
+ * of fp clear while the chunk is shorter than avgSize, the top log2(avgSize) - 2 bits after,
+ * and a chunk is cut at maxSize regardless. Cut points only depend on the data, not on how
+ * the stream is split into updates.
+ *
+ * @param st Chunker state, carried from one part of the stream to the next.
+ * @param data Next part of the stream.
+ * @param final Last part, the chunk in progress is closed as well.
+ * @param records Receives a SHA256_CDC_RECORD_SIZE record per chunk that ended.
+ *
+ * @return returns the number of records written.
+ */
+
+size_t sha256_cdc_update(SHA256CdcState *st, const SHA256CdcParams *p, const uint8_t *data, size_t len,
+                         bool final, uint8_t *records) {
+
+	int bits = 63 - clz64(p->avgSize);
+	uint64_t maskSmall = ~0ULL << (64 - (bits + 2));	// Harder before avgSize
+	uint64_t maskLarge = ~0ULL << (64 - (bits - 2));	// Easier after
+	size_t count = 0;
+
+	while (len > 0) {
+		uint64_t fp = st->fingerprint;
+		uint32_t n = st->length;
+		size_t i = 0;
+		bool cut = false;
+
+		if (n < p->minSize) {
+			i = MIN(len, p->minSize - n);
+			n += i;
+		}
+		while (i < len) {
+			if (n == p->maxSize) {
+				cut = true;
+				break;
+			}
+			fp = (fp << 1) + cdcGear[data[i]];
+			++i;
+			++n;
+			if (!(fp & (n <= p->avgSize ? maskSmall : maskLarge))) {
+				cut = true;
+				break;
+			}
+		}
+
+		sha256_update(&st->hash, data, i);
+		st->fingerprint = fp;
+		st->length = n;
+		data += i;
+		len -= i;
+		if (cut) {
+			sha_cdc_emit(st, records + count++ * SHA256_CDC_RECORD_SIZE);
+		}
+	}
+
+	if (final) {
+		if (st->length > 0) {
+			sha_cdc_emit(st, records + count++ * SHA256_CDC_RECORD_SIZE);
+		}
+		sha256_cdc_init(st);
+	}
+	return count;
+}
+
+/* MMIO Trace Capture ----------------------------------------------------------------- */
+
+SHA256Trace *sha256_trace_open(const char *path, uint32_t inputSize, uint32_t contexts, Error **errp)
+{
+    SHA256TraceHeader header = { .inputSize = inputSize, .contexts = contexts };
+    SHA256Trace *trace;
+    FILE *file = fopen(path, "wb");
+
+    if (!file) {
+        error_setg_errno(errp, errno, "cannot open trace-file '%s'", path);
+        return NULL;
+    }
+
+    memcpy(header.magic, SHA256_TRACE_MAGIC, sizeof(header.magic));
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        error_setg_errno(errp, errno, "cannot write trace-file '%s'", path);
+        fclose(file);
+        return NULL;
+    }
+
+    trace = g_new0(SHA256Trace, 1);
+    trace->file = file;
+    qemu_mutex_init(&trace->lock);
+    return trace;
+}
+
+void sha256_trace_close(SHA256Trace *trace)
+{
+    if (trace) {
+        fclose(trace->file);
+        qemu_mutex_destroy(&trace->lock);
+        g_free(trace);
+    }
+}
+
+/* Appends one record, called with the context lock held so a context's records stay in order */
+static void sha_trace_record(SHA256Core *s, uint8_t kind, hwaddr addr, unsigned int size, uint64_t data)
+{
+    SHA256TraceRecord rec = {
+        .timeNs = qemu_clock_get_ns(QEMU_CLOCK_REALTIME),
+        .data = data,
+        .addr = addr,
+        .context = s->traceIndex,
+        .kind = kind,
+        .size = size,
+    };
+
+    qemu_mutex_lock(&s->trace->lock);
+    fwrite(&rec, sizeof(rec), 1, s->trace->file);
+    qemu_mutex_unlock(&s->trace->lock);
+}
+
+/* Register File ---------------------------------------------------------------------- */
+
+/* Status register: per-bank state, bank 0 in bits 0-3 and bank 1 in bits 4-7 */
+static uint32_t sha_device_status(SHA256Core *s)
+{
+    uint32_t status = 0;
+
+    for (int i = 0; i < numBanks; ++i) {
+        if (s->banks[i].state == BANK_DONE) {
+            status |= statusDONE(i);
+        } else if (s->banks[i].state == BANK_BUSY) {
+            status |= statusBUSY(i);
+        }
+    }
+    return status;
+}
+
+/* Bytes of the message held in a bank, strnlen for guests that never write LEN_REG */
+static size_t sha_bank_length(SHA256Core *s, SHA256Bank *bank)
+{
+    return bank->lengthValid ? bank->length : strnlen(bank->inputBuffer, s->inputSize);
+}
+
+/* Drops the blocks absorbed from eagerBank and their count, called with the lock held */
+static void sha_eager_rollback(SHA256Core *s)
+{
+    if (s->eagerBank >= 0) {
+        s->stream = s->eagerBase;
+        s->stats.blocks -= s->eagerLen / CHUNK_SIZE;
+        s->eagerBank = -1;
+        s->eagerLen = 0;
+    }
+}
+
+/*
+ * Compress-on-write: absorbs the complete 64 byte blocks written in order into the fill
+ * bank, so a start only has the tail and the padding left to hash. Only done while no job
+ * is queued, as such a job precedes the fill bank in the message. Called with the lock held.
+ */
+static void sha_eager_absorb(SHA256Core *s)
+{
+    SHA256Bank *bank = &s->banks[s->fillBank];
+    uint32_t written = s->writtenLen[s->fillBank];
+
+    if (s->jobCount != 0 || (s->eagerBank >= 0 && s->eagerBank != (int)s->fillBank)) {
+        return;
+    }
+
+    while (written - s->eagerLen >= 64) {
+        if (s->eagerBank < 0) {
+            s->eagerBase = s->stream;
+            s->eagerBank = s->fillBank;
+        }
+        sha256_update(&s->stream, (const uint8_t *)bank->inputBuffer + s->eagerLen, 64);
+        s->eagerLen += 64;
+        s->stats.blocks++;
+    }
+}
+
+static void *sha_device_worker(void *opaque)
+{
+    SHA256Core *s = (SHA256Core *)opaque;
+    uint8_t result[outputBufferSize];
+
+    qemu_mutex_lock(&s->lock);
+    while (true) {
+        while (s->jobCount == 0 && !s->stopping) {
+            qemu_cond_wait(&s->jobCond, &s->lock);
+        }
+        if (s->stopping) {
+            break;
+        }
+
+        SHA256Bank *bank = &s->banks[s->jobQueue[s->jobHead]];
+        SHA256KdfParams kdf = bank->kdf;
+        SHA256CdcParams cdc = bank->cdc;
+        uint32_t op = bank->op;
+        size_t len = op == opHASH || op == opCDC ? sha_bank_length(s, bank) : kdf.keyLen + kdf.saltLen + kdf.infoLen;
+        size_t records = 0;
+        size_t absorbed = bank->absorbed;
+        bool more = bank->more;
+        const uint8_t *in = (const uint8_t *)bank->inputBuffer;
+        uint64_t blocks = 0;
+        int64_t start;
+
+        // The bank is busy so the guest cannot touch it, hash it without holding the lock
+        qemu_mutex_unlock(&s->lock);
+        start = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+        if (op == opCDC) {
+            records = sha256_cdc_update(&s->chunker, &cdc, in, len, !more, s->resultBuffer);
+        } else if (op == opPBKDF2) {
+            sha256_pbkdf2(in, kdf.keyLen, in + kdf.keyLen, kdf.saltLen, kdf.iterations, s->resultBuffer, kdf.outLen);
+        } else if (op != opHASH) {
+            sha256_hkdf(in, kdf.keyLen, in + kdf.keyLen, kdf.saltLen, in + kdf.keyLen + kdf.saltLen, kdf.infoLen,
+                        op == opHKDF, s->resultBuffer, kdf.outLen);
+        } else {
+            blocks = (s->stream.blockLen + len - absorbed) / CHUNK_SIZE;
+            sha256_update(&s->stream, in + absorbed, len - absorbed);
+            if (!more) {
+                blocks += s->stream.blockLen > CHUNK_SIZE - 9 ? 2 : 1;      // Padding and length
+                sha256_final(&s->stream, result);
+                sha256_init(&s->stream);
+            }
+        }
+        qemu_mutex_lock(&s->lock);
+
+        s->stats.jobs++;
+        s->stats.bytes += len;
+        s->stats.blocks += blocks;
+        s->stats.busyNs += qemu_clock_get_ns(QEMU_CLOCK_REALTIME) - start;
+
+        if (op == opCDC) {
+            // Records over the start of the bank, the digest of the last chunk in the output register
+            memcpy(bank->inputBuffer, s->resultBuffer, records * SHA256_CDC_RECORD_SIZE);
+            bank->cdcRecords = records;
+            if (records > 0) {
+                memcpy(s->outputBuffer, s->resultBuffer + (records - 1) * SHA256_CDC_RECORD_SIZE + 16,
+                       outputBufferSize);
+            }
+        } else if (op != opHASH) {
+            // Derived key over the start of the bank, its first 32 bytes in the output register
+            memcpy(bank->inputBuffer, s->resultBuffer, kdf.outLen);
+            memset(s->outputBuffer, 0, outputBufferSize);
+            memcpy(s->outputBuffer, s->resultBuffer, MIN(kdf.outLen, outputBufferSize));
+        } else if (!more) {
+            memcpy(s->outputBuffer, result, outputBufferSize * sizeof(uint8_t)); 	// Copy 256 bit hash (32 elements * 1 byte per element)
+        }
+        bank->state = BANK_DONE;
+        bank->lengthValid = false;
+        bank->absorbed = 0;
+        bank->op = opHASH;
+        if (s->trace) {
+            sha_trace_record(s, SHA256_TRACE_JOB_DONE, bank - s->banks, more, len);
+        }
+        s->jobHead = (s->jobHead + 1) % numBanks;
+        s->jobCount--;
+        if (s->jobCount == 0) {
+            qemu_cond_broadcast(&s->idleCond);
+        }
+
+        // Interrupts are raised from the main loop, the bottom half is safe to schedule here
+        if (s->notify && (s->irqEnable & irqDONE)) {
+            qemu_bh_schedule(s->notify);
+        }
+    }
+    qemu_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+/*
+ * Checks the latched CDC registers, the records of a part must fit in the bank: at most one
+ * per minSize bytes, plus the chunk carried in and the one closed by a final part.
+ */
+static bool sha_cdc_check(SHA256Core *s)
+{
+    const SHA256CdcParams *cdc = &s->cdc;
+
+    if (cdc->minSize < CHUNK_SIZE || cdc->avgSize < cdc->minSize || cdc->maxSize < cdc->avgSize ||
+        (uint64_t)SHA256_CDC_RECORD_SIZE * (s->inputSize / cdc->minSize + 2) > s->inputSize) {
+        qemu_log_mask(LOG_GUEST_ERROR, "sha_device_write: Invalid chunking parameters %u/%u/%u\n",
+                      cdc->minSize, cdc->avgSize, cdc->maxSize);
+        return false;
+    }
+    return true;
+}
+
+/* Checks the latched KDF registers against the operation, logs and returns false if unusable */
+static bool sha_kdf_check(SHA256Core *s, uint32_t op, bool more)
+{
+    const SHA256KdfParams *kdf = &s->kdf;
+    uint64_t inLen = (uint64_t)kdf->keyLen + kdf->saltLen + kdf->infoLen;
+    // A job cannot be interrupted and reset waits for it, so the PBKDF2 chain is bounded
+    uint64_t work = (uint64_t)kdf->iterations * ((kdf->outLen + outputBufferSize - 1) / outputBufferSize);
+
+    if (op > opCDC || (more && op != opCDC)) {
+        qemu_log_mask(LOG_GUEST_ERROR, "sha_device_write: Operation %u cannot be started%s\n", op,
+                      more ? " as a non-final part" : "");
+        return false;
+    }
+    if (op == opCDC) {
+        return true;
+    }
+    if (inLen > s->inputSize || kdf->outLen == 0 || kdf->outLen > s->inputSize ||
+        (op == opPBKDF2 && (kdf->iterations == 0 || work > pbkdf2MaxWork)) ||
+        (op != opPBKDF2 && kdf->outLen > hkdfMaxOutput)) {
+        qemu_log_mask(LOG_GUEST_ERROR, "sha_device_write: Invalid key derivation parameters for operation %u\n", op);
+        return false;
+    }
+    return true;
+}
+
+/* Queue a bank for hashing or key derivation, called with the lock held */
+static void sha_device_start(SHA256Core *s, uint32_t bankIndex, bool more, uint32_t op)
+{
+    SHA256Bank *bank = &s->banks[bankIndex];
+
+    if (bank->state == BANK_BUSY) {
+        qemu_log_mask(LOG_GUEST_ERROR, "sha_device_write: Bank %u started while still busy\n", bankIndex);
+        return;
+    }
+
+    if (op != opHASH) {
+        if (!sha_kdf_check(s, op, more) || (op == opCDC && !sha_cdc_check(s))) {
+            return;
+        }
+        // Key derivation and chunking do not use the running hash, only blocks absorbed from this bank are void
+        if (s->eagerBank == (int)bankIndex) {
+            sha_eager_rollback(s);
+        }
+        bank->absorbed = 0;
+        bank->kdf = s->kdf;
+        bank->cdc = s->cdc;
+    } else {
+        // Absorbed blocks belong to this job, unless another bank goes first or the job is shorter
+        if (s->eagerBank >= 0 && (s->eagerBank != (int)bankIndex || sha_bank_length(s, bank) < s->eagerLen)) {
+            sha_eager_rollback(s);
+        }
+        bank->absorbed = s->eagerLen;
+        s->eagerBank = -1;
+        s->eagerLen = 0;
+    }
+    s->writtenLen[bankIndex] = 0;
+
+    bank->state = BANK_BUSY;
+    bank->more = more;
+    bank->op = op;
+    s->jobQueue[(s->jobHead + s->jobCount) % numBanks] = bankIndex;
+    s->jobCount++;
+    qemu_cond_signal(&s->jobCond);
+}
+
+/* Wait for queued jobs and return to the power-on state, called with the lock held */
+static void sha_device_reset(SHA256Core *s)
+{
+    while (s->jobCount > 0) {
+        qemu_cond_wait(&s->idleCond, &s->lock);
+    }
+
+    for (int i = 0; i < numBanks; ++i) {
+        memset(s->banks[i].inputBuffer, 0, s->inputSize); 				// Clear the input buffer
+        s->banks[i].length = 0;
+        s->banks[i].lengthValid = false;
+        s->banks[i].absorbed = 0;
+        s->banks[i].op = opHASH;
+        s->banks[i].cdcRecords = 0;
+        s->banks[i].state = BANK_IDLE;
+        s->writtenLen[i] = 0;
+    }
+    memset(s->outputBuffer, 0, outputBufferSize * sizeof(uint8_t)); 	// Clear the output buffer
+    memset(&s->kdf, 0, sizeof(s->kdf));
+    memset(&s->cdc, 0, sizeof(s->cdc));
+    sha256_cdc_init(&s->chunker);
+    sha_eager_rollback(s);
+    s->fillBank = 0;
+    sha256_init(&s->stream);
+}
+
+static uint64_t sha_device_read_locked(SHA256Core *s, hwaddr addr, unsigned int size)
 {
-    SHA256DeviceState *s = (SHA256DeviceState *)opaque;
 	uint64_t data = 0;
+    uint8_t *inputBuffer = (uint8_t *)s->banks[s->fillBank].inputBuffer;  // Unsigned, bytes >= 0x80 must not sign-extend
 
     // Handle specific device registers
     switch (addr) {
         case ID_REG: 			// Device ID Register
 			return DEVICE_ID;	// Return the predefined device ID
 
+        case CAP_REG: 			// Capability Register
+			return s->inputSize;	// Advertise the input window size to the driver
+
         case CTRL_REG: 			// Control Register
 			return s->control;	// Return the current value of the control register
 
         case STATUS_REG: 		// Status Register
-			return s->status; 	// Return the current value of the status register
+			return sha_device_status(s); 	// Return the per-bank state
+    }
+
+    if (addr == LEN_REG(s)) {
+        return s->banks[s->fillBank].length;
+    } else if (addr == IRQ_REG(s)) {
+        return s->irqEnable;
+    } else if (addr == QUEUES_REG(s)) {
+        return s->queueCount;
+    } else if (addr == KDF_ITER_REG(s)) {
+        return s->kdf.iterations;
+    } else if (addr == KDF_KEYLEN_REG(s)) {
+        return s->kdf.keyLen;
+    } else if (addr == KDF_SALTLEN_REG(s)) {
+        return s->kdf.saltLen;
+    } else if (addr == KDF_INFOLEN_REG(s)) {
+        return s->kdf.infoLen;
+    } else if (addr == KDF_OUTLEN_REG(s)) {
+        return s->kdf.outLen;
+    } else if (addr == CDC_MIN_REG(s)) {
+        return s->cdc.minSize;
+    } else if (addr == CDC_AVG_REG(s)) {
+        return s->cdc.avgSize;
+    } else if (addr == CDC_MAX_REG(s)) {
+        return s->cdc.maxSize;
+    } else if (addr == CDC_COUNT_REG(s)) {
+        return s->banks[s->fillBank].cdcRecords;
     }
 
 	// Handle memory-mapped I/O for input and output buffers
     
-    if (addr >= INPUT_REG && addr < INPUT_REG + inputBufferSize) {
+    if (addr >= INPUT_REG && addr < INPUT_REG + s->inputSize) {
         
 		// Calculate the exact byte offset within the input buffer
         int offset = addr - INPUT_REG;
@@ -301,20 +1171,20 @@ static uint64_t sha_device_read(void *opaque, hwaddr addr, unsigned int size)
 		// printf("sha_device_read: Reading from input register at address: 0x%08x\n", (int)addr);
         
         // Ensure the offset is within bounds
-        if (offset + size > inputBufferSize) {
+        if (offset + size > s->inputSize) {
             printf("sha_device_read: Read out of bounds\n");
             return 0xDEADBEEF; // Return error value for out-of-bounds read
         } else {
 			switch (size) {
 				case 1:
-					data = s->inputBuffer[offset];
+					data = inputBuffer[offset];
 					break;
 				case 2:
-					data = s->inputBuffer[offset] | (s->inputBuffer[offset + 1] << 8);
+					data = inputBuffer[offset] | (inputBuffer[offset + 1] << 8);
 					break;
 				case 4:
-					data = s->inputBuffer[offset] | (s->inputBuffer[offset + 1] << 8) |
-						(s->inputBuffer[offset + 2] << 16) | (s->inputBuffer[offset + 3] << 24);
+					data = inputBuffer[offset] | (inputBuffer[offset + 1] << 8) |
+						(inputBuffer[offset + 2] << 16) | ((uint32_t)inputBuffer[offset + 3] << 24);
 					break;
 				default:
 					printf("sha_device_read: Invalid read size %u at address 0x%08x\n", size, (int)addr);
@@ -323,10 +1193,10 @@ static uint64_t sha_device_read(void *opaque, hwaddr addr, unsigned int size)
 			return data;
 		}
 
-    } else if (addr >= OUTPUT_REG && addr < OUTPUT_REG + outputBufferSize) {
+    } else if (addr >= OUTPUT_REG(s) && addr < OUTPUT_REG(s) + outputBufferSize) {
         
 		// Calculate the exact byte offset within the output buffer
-        int offset = addr - OUTPUT_REG;
+        int offset = addr - OUTPUT_REG(s);
         
 		// For Debugging
 		// printf("sha_device_read: Reading from output register at address: 0x%08x\n", (int)addr);
@@ -345,7 +1215,7 @@ static uint64_t sha_device_read(void *opaque, hwaddr addr, unsigned int size)
 					break;
 				case 4:
 					data = ((uint8_t*)s->outputBuffer)[offset] | (((uint8_t*)s->outputBuffer)[offset + 1] << 8) |
-						(((uint8_t*)s->outputBuffer)[offset + 2] << 16) | (((uint8_t*)s->outputBuffer)[offset + 3] << 24);
+						(((uint8_t*)s->outputBuffer)[offset + 2] << 16) | ((uint32_t)((uint8_t*)s->outputBuffer)[offset + 3] << 24);
 					break;
 				default:
 					printf("sha_device_read: Invalid read size %u at address 0x%08x\n", size, (int)addr);
@@ -363,9 +1233,23 @@ static uint64_t sha_device_read(void *opaque, hwaddr addr, unsigned int size)
     return 0;
 }
 
-static void sha_device_write(void *opaque, hwaddr addr, uint64_t data, unsigned int size)
+static uint64_t sha_device_read(void *opaque, hwaddr addr, unsigned int size)
+{
+    SHA256Core *s = (SHA256Core *)opaque;
+    uint64_t data;
+
+    qemu_mutex_lock(&s->lock);
+    data = sha_device_read_locked(s, addr, size);
+    if (s->trace) {
+        sha_trace_record(s, SHA256_TRACE_READ, addr, size, data);
+    }
+    qemu_mutex_unlock(&s->lock);
+    return data;
+}
+
+static void sha_device_write_locked(SHA256Core *s, hwaddr addr, uint64_t data, unsigned int size)
 {
-    SHA256DeviceState *s = (SHA256DeviceState *)opaque;
+    SHA256Bank *bank = &s->banks[s->fillBank];
 
     // Handling specific control registers
     
@@ -373,43 +1257,19 @@ static void sha_device_write(void *opaque, hwaddr addr, uint64_t data, unsigned
         case CTRL_REG: 				// Control Register
 			s->control = data; 								// Update the control register
 			
-			if (data == deviceEN) { 						// Check if the enable bit is set to start hashing
-				
-				perform_sha256_hashing(s->inputBuffer);
-				memcpy(s->outputBuffer, digest, outputBufferSize * sizeof(uint8_t)); 	// Copy 256 bit hash (32 elements * 1 byte per element)
-				s->status = 1; 		// Update the status register to indicate completion
-			
-				/* Debugging Print Statements */
-				/*
-				// Input Buffer Checking
-				printf("sha_device_write: Data in input register: ");
-				for (int i = 0; i < inputBufferSize; i++) {
-					printf("%02X", (unsigned char)s->inputBuffer[i]);
-				}
-				printf("\n");
-
-				// Temporary Buffer Checking
-				printf("sha_device_write: Writing output digest.\n");
-				printf("SHA256 Digest: ");
-				for (int i = 0; i < 32; ++i) {
-					printf("%02X", digest[i]);
-				}
-				printf("\n");
-
-				// Output Buffer Checking
-				printf("sha_device_write: Data in output register: ");
-				for (int i = 0; i < outputBufferSize; ++i) {
-					printf("%02X", s->outputBuffer[i]);
-				}
-				printf("\n");
-			*/			
-			} else if (data == deviceRST) {
-
-				printf("sha_device_write: Resetting SHA256 Accelerator Core.");
-			 	s->status = 0; 														// Reset the status register
-				memset(s->inputBuffer, 0, inputBufferSize); 						// Clear the input buffer
-    			memset(s->outputBuffer, 0, outputBufferSize * sizeof(uint8_t)); 	// Clear the output buffer
- 
+			if (data == deviceRST) {
+
+				printf("sha_device_write: Resetting SHA256 Accelerator Core.\n");
+				sha_device_reset(s);
+				return;
+			}
+
+			if (data & deviceSELECT) {						// Map the selected bank into the input window
+				s->fillBank = CTRL_BANK(data);
+			}
+
+			if (data & deviceEN) { 							// Check if the enable bit is set to start hashing
+				sha_device_start(s, CTRL_BANK(data), data & deviceMORE, CTRL_OP(data));
 			}
 			return;
 
@@ -417,11 +1277,73 @@ static void sha_device_write(void *opaque, hwaddr addr, uint64_t data, unsigned
             break;
     }
 
+    if (addr == LEN_REG(s)) {
+        if (bank->state == BANK_BUSY) {
+            qemu_log_mask(LOG_GUEST_ERROR, "sha_device_write: Length written while bank %u is busy\n", s->fillBank);
+            return;
+        }
+        bank->length = MIN(data, s->inputSize);
+        bank->lengthValid = true;
+        return;
+    } else if (addr == IRQ_REG(s)) {
+        s->irqEnable = data & irqDONE;
+        return;
+    } else if (addr == KDF_ITER_REG(s)) {
+        s->kdf.iterations = data;
+        return;
+    } else if (addr == KDF_KEYLEN_REG(s)) {
+        s->kdf.keyLen = data;
+        return;
+    } else if (addr == KDF_SALTLEN_REG(s)) {
+        s->kdf.saltLen = data;
+        return;
+    } else if (addr == KDF_INFOLEN_REG(s)) {
+        s->kdf.infoLen = data;
+        return;
+    } else if (addr == KDF_OUTLEN_REG(s)) {
+        s->kdf.outLen = data;
+        return;
+    } else if (addr == CDC_MIN_REG(s)) {
+        s->cdc.minSize = data;
+        return;
+    } else if (addr == CDC_AVG_REG(s)) {
+        s->cdc.avgSize = data;
+        return;
+    } else if (addr == CDC_MAX_REG(s)) {
+        s->cdc.maxSize = data;
+        return;
+    }
+
     // Handle writes to the input buffer
-    if (addr >= INPUT_REG && addr < INPUT_REG + inputBufferSize) {
+    if (addr >= INPUT_REG && addr < INPUT_REG + s->inputSize) {
         // Calculate the exact byte offset within the input buffer
         int offset = addr - INPUT_REG;
-		s->inputBuffer[offset] = data;
+
+        // Ensure the whole access fits in the window, the region is larger than the window now
+        if (offset + size > s->inputSize) {
+            qemu_log_mask(LOG_GUEST_ERROR, "sha_device_write: Write out of bounds at address 0x%08x\n", (int)addr);
+            return;
+        }
+
+        // The worker reads a busy bank without holding the lock
+        if (bank->state == BANK_BUSY) {
+            qemu_log_mask(LOG_GUEST_ERROR, "sha_device_write: Write to busy bank %u dropped\n", s->fillBank);
+            return;
+        }
+
+        // Store every byte of the access, least significant byte first
+        for (unsigned int i = 0; i < size; ++i) {
+            bank->inputBuffer[offset + i] = (data >> (i * 8)) & 0xFF;
+        }
+
+        // Rewriting absorbed bytes undoes the absorption, in-order writes extend the prefix
+        if (s->eagerBank == (int)s->fillBank && offset < (int)s->eagerLen) {
+            sha_eager_rollback(s);
+        }
+        if (offset <= (int)s->writtenLen[s->fillBank] && offset + size > s->writtenLen[s->fillBank]) {
+            s->writtenLen[s->fillBank] = offset + size;
+        }
+        sha_eager_absorb(s);
 		
 		// For Debugging
 		// printf("sha_device_write: Writing to input register: %llu at address: 0x%08x of size: %u\n", (unsigned long long)data, (int)addr, size);
@@ -434,32 +1356,258 @@ static void sha_device_write(void *opaque, hwaddr addr, uint64_t data, unsigned
 
 }
 
-static const MemoryRegionOps sha_device_ops = {
+static void sha_device_write(void *opaque, hwaddr addr, uint64_t data, unsigned int size)
+{
+    SHA256Core *s = (SHA256Core *)opaque;
+
+    qemu_mutex_lock(&s->lock);
+    if (s->trace) {
+        sha_trace_record(s, SHA256_TRACE_WRITE, addr, size, data);
+    }
+    sha_device_write_locked(s, addr, data, size);
+    qemu_mutex_unlock(&s->lock);
+}
+
+/* Statistics ------------------------------------------------------------------------ */
+
+/* Every initialised core in creation order, changed and walked with the BQL held */
+static QTAILQ_HEAD(, SHA256Core) sha256Cores = QTAILQ_HEAD_INITIALIZER(sha256Cores);
+
+/* Copies the counters of a context, with the current queue depth */
+void sha256_core_get_stats(SHA256Core *s, SHA256CoreStats *stats)
+{
+    qemu_mutex_lock(&s->lock);
+    *stats = s->stats;
+    stats->queueDepth = s->jobCount;
+    qemu_mutex_unlock(&s->lock);
+}
+
+/* Calls fn for every core of every device, the contexts of a device are adjacent and in order */
+void sha256_core_foreach(void (*fn)(SHA256Core *s, void *opaque), void *opaque)
+{
+    SHA256Core *s;
+
+    QTAILQ_FOREACH(s, &sha256Cores, next) {
+        fn(s, opaque);
+    }
+}
+
+/* Shared by every device exposing the register file, the region opaque is the SHA256Core */
+const MemoryRegionOps sha256_core_ops = {
 	.read = sha_device_read,
     .write = sha_device_write,
     .endianness = DEVICE_NATIVE_ENDIAN,
 };
 
-static void sha_instance_init(Object *obj)
+/**
+ * @brief Checks an "input-size" property value. The window is accessed with up to 4 byte
+ * wide accesses, so it is kept word aligned.
+ *
+ * @return returns true if the size is usable, otherwise sets errp.
+ */
+
+bool sha256_core_check_input_size(uint32_t inputSize, Error **errp)
 {
-    SHA256DeviceState *s = SHA256_DEVICE(obj);
+    if (inputSize < CHUNK_SIZE || inputSize > maxInputBufferSize || inputSize % 4) {
+        error_setg(errp, "input-size must be a multiple of 4 between %d and %d",
+                   CHUNK_SIZE, maxInputBufferSize);
+        return false;
+    }
+    return true;
+}
 
-	/* allocate memory map region */ 
-    memory_region_init_io(&s->iomem, obj, &sha_device_ops, s, "sha256_device", 0x1000);
-    sysbus_init_mmio(SYS_BUS_DEVICE(s), &s->iomem);
+/* Smallest power of 2 region holding the register file, also the per-queue stride on PCI */
+uint64_t sha256_core_region_size(uint32_t inputSize)
+{
+    return MAX(pow2ceil(INPUT_REG + inputSize + outputBufferSize + extRegBlockSize), minMmioSize);
+}
+
+/**
+ * @brief Brings up one register file: allocates the banks and starts its worker thread.
+ *
+ * @param s Register file to initialise.
+ * @param inputSize Input window size, checked with sha256_core_check_input_size().
+ * @param queueCount Value returned by QUEUES_REG, the number of contexts of the device.
+ * @param notify Bottom half scheduled when a job completes with interrupts enabled, or NULL.
+ */
 
-    // Initialize the state of the device
-    s->status = 0; 									// Set initial status as 0 (e.g., device ready or idle)
+void sha256_core_init(SHA256Core *s, uint32_t inputSize, uint32_t queueCount, QEMUBH *notify)
+{
+    s->inputSize = inputSize;
+    s->queueCount = queueCount;
+    s->notify = notify;
     s->control = 0; 								// Ensure the control register is set to 0 initially
-    memset(s->inputBuffer, 0, inputBufferSize); 	// Clear the input buffer
+    s->irqEnable = 0;
+    s->fillBank = 0;
     memset(s->outputBuffer, 0, outputBufferSize * sizeof(uint8_t)); 	// Clear the output buffer
+    sha256_init(&s->stream);
+
+    for (int i = 0; i < numBanks; ++i) {
+        s->banks[i].inputBuffer = g_malloc0(s->inputSize);
+        s->banks[i].length = 0;
+        s->banks[i].lengthValid = false;
+        s->banks[i].absorbed = 0;
+        s->banks[i].op = opHASH;
+        s->banks[i].cdcRecords = 0;
+        s->banks[i].state = BANK_IDLE;
+        s->writtenLen[i] = 0;
+    }
+    s->eagerBank = -1;
+    s->eagerLen = 0;
+    memset(&s->kdf, 0, sizeof(s->kdf));
+    memset(&s->cdc, 0, sizeof(s->cdc));
+    sha256_cdc_init(&s->chunker);
+    s->resultBuffer = g_malloc0(s->inputSize);
+    memset(&s->stats, 0, sizeof(s->stats));
+    QTAILQ_INSERT_TAIL(&sha256Cores, s, next);
+
+    qemu_mutex_init(&s->lock);
+    qemu_cond_init(&s->jobCond);
+    qemu_cond_init(&s->idleCond);
+    s->jobHead = 0;
+    s->jobCount = 0;
+    s->stopping = false;
+    qemu_thread_create(&s->worker, "sha256-worker", sha_device_worker, s, QEMU_THREAD_JOINABLE);
+}
+
+/* Stops the worker, dropping queued jobs, and frees the banks */
+void sha256_core_cleanup(SHA256Core *s)
+{
+    qemu_mutex_lock(&s->lock);
+    s->stopping = true;
+    qemu_cond_signal(&s->jobCond);
+    qemu_mutex_unlock(&s->lock);
+    qemu_thread_join(&s->worker);
+    QTAILQ_REMOVE(&sha256Cores, s, next);
+
+    qemu_cond_destroy(&s->idleCond);
+    qemu_cond_destroy(&s->jobCond);
+    qemu_mutex_destroy(&s->lock);
+
+    for (int i = 0; i < numBanks; ++i) {
+        g_free(s->banks[i].inputBuffer);
+        s->banks[i].inputBuffer = NULL;
+    }
+    g_free(s->resultBuffer);
+    s->resultBuffer = NULL;
+}
+
+/* Device Modelling with QOM ------------------- ------------------------------------- */
+
+struct SHA256DeviceState {
+    SysBusDevice parent_obj;
+    MemoryRegion iomem;    						// Memory region for device I/O, a container of the context pages
+    MemoryRegion *ctxRegions;                   // One register page per context
+    SHA256Core *contexts;                       // Register file, banks and worker of each context
+    uint32_t numContexts;                       // Number of contexts ("contexts" property)
+    uint32_t inputSize;         				// Input window size in bytes ("input-size" property)
+    uint64_t mmioSize;          				// MMIO region size ("mmio-size" property, 0 selects the smallest fit)
+    char *traceFile;                            // Capture register accesses here ("trace-file" property)
+    SHA256Trace *trace;
+};
+
+static void sha_device_realize(DeviceState *dev, Error **errp)
+{
+    SHA256DeviceState *s = SHA256_DEVICE(dev);
+    uint64_t stride, needed;
+
+    if (!sha256_core_check_input_size(s->inputSize, errp)) {
+        return;
+    }
+
+    if (s->numContexts < 1 || s->numContexts > maxContexts) {
+        error_setg(errp, "sha256_device: contexts must be between 1 and %d", maxContexts);
+        return;
+    }
+
+    // Context i starts at i * stride, a single context keeps the whole region as before
+    stride = sha256_core_region_size(s->inputSize);
+    needed = s->numContexts > 1 ? s->numContexts * stride : INPUT_REG + s->inputSize + outputBufferSize + extRegBlockSize;
+    if (s->mmioSize == 0) {
+        s->mmioSize = pow2ceil(MAX(needed, stride));
+    } else if (s->mmioSize < needed) {
+        error_setg(errp, "sha256_device: mmio-size 0x%" PRIx64 " cannot hold %u context(s) with a %u byte "
+                   "input window (needs at least 0x%" PRIx64 ")", s->mmioSize, s->numContexts, s->inputSize, needed);
+        return;
+    }
+    if (s->numContexts == 1) {
+        stride = s->mmioSize;
+    }
+
+    if (s->traceFile) {
+        s->trace = sha256_trace_open(s->traceFile, s->inputSize, s->numContexts, errp);
+        if (!s->trace) {
+            return;
+        }
+    }
+
+	/* allocate memory map region */ 
+    memory_region_init(&s->iomem, OBJECT(s), "sha256_device", s->mmioSize);
+
+    s->contexts = g_new0(SHA256Core, s->numContexts);
+    s->ctxRegions = g_new0(MemoryRegion, s->numContexts);
+    for (uint32_t i = 0; i < s->numContexts; ++i) {
+        // No interrupt line, the driver polls STATUS_REG
+        sha256_core_init(&s->contexts[i], s->inputSize, s->numContexts, NULL);
+        s->contexts[i].trace = s->trace;
+        s->contexts[i].traceIndex = i;
+        s->contexts[i].owner = OBJECT(s);
+
+        // Each context has its own lock, so accesses skip the BQL and vCPUs on different
+        // contexts never contend
+        memory_region_init_io(&s->ctxRegions[i], OBJECT(s), &sha256_core_ops, &s->contexts[i],
+                              "sha256_device-context", stride);
+        memory_region_clear_global_locking(&s->ctxRegions[i]);
+        memory_region_add_subregion(&s->iomem, i * stride, &s->ctxRegions[i]);
+    }
+    sysbus_init_mmio(SYS_BUS_DEVICE(s), &s->iomem);
+}
+
+static void sha_device_unrealize(DeviceState *dev)
+{
+    SHA256DeviceState *s = SHA256_DEVICE(dev);
+
+    for (uint32_t i = 0; i < s->numContexts; ++i) {
+        sha256_core_cleanup(&s->contexts[i]);
+    }
+    g_free(s->contexts);
+    s->contexts = NULL;
+
+    sha256_trace_close(s->trace);
+    s->trace = NULL;
+}
+
+/* The context pages are children of the device and are gone by the time it is finalized */
+static void sha_instance_finalize(Object *obj)
+{
+    SHA256DeviceState *s = SHA256_DEVICE(obj);
+
+    g_free(s->ctxRegions);
+}
+
+static Property sha256_device_properties[] = {
+    DEFINE_PROP_UINT32("input-size", SHA256DeviceState, inputSize, inputBufferSize),
+    DEFINE_PROP_UINT64("mmio-size", SHA256DeviceState, mmioSize, 0),
+    DEFINE_PROP_UINT32("contexts", SHA256DeviceState, numContexts, 1),
+    DEFINE_PROP_STRING("trace-file", SHA256DeviceState, traceFile),
+    DEFINE_PROP_END_OF_LIST(),
+};
+
+static void sha256_device_class_init(ObjectClass *klass, void *data)
+{
+    DeviceClass *dc = DEVICE_CLASS(klass);
+
+    dc->realize = sha_device_realize;
+    dc->unrealize = sha_device_unrealize;
+    device_class_set_props(dc, sha256_device_properties);
 }
 
 static TypeInfo sha256_device_info = {
     .name = TYPE_SHA256_DEVICE,
     .parent = TYPE_SYS_BUS_DEVICE,
     .instance_size = sizeof(SHA256DeviceState),
-    .instance_init = sha_instance_init,
+    .instance_finalize = sha_instance_finalize,
+    .class_init = sha256_device_class_init,
 };
 
 static void sha256_device_register_types(void)
@@ -2,11 +2,194 @@
 #define HW_SHA256_DEVICE_H
 
 #include "qom/object.h"
+#include "exec/memory.h"
+#include "qemu/thread.h"
+#include "qemu/queue.h"
+
+#define SHA256_DIGEST_SIZE  32
+#define SHA256_NUM_BANKS    2
+
+/* Compression backend: processes one 64 byte block into the running hash values */
+typedef struct SHA256Backend {
+    const char *name;
+    void (*process_block)(uint32_t hashVal[], const uint8_t *block);
+} SHA256Backend;
+
+/* Streaming hash state, lets a message be absorbed over several device jobs */
+typedef struct SHA256Context {
+    uint32_t hashVal[8];
+    uint8_t block[64];          // Partial block carried over between updates
+    size_t blockLen;
+    uint64_t totalLen;          // Bytes absorbed so far
+} SHA256Context;
+
+/* Content-Defined Chunking ---------------------------------------------------------- */
+
+/*
+ * Record written by opCDC for every chunk, little endian: stream offset (8 bytes), length
+ * (4), reserved (4) and the SHA-256 of the chunk (32).
+ */
+#define SHA256_CDC_RECORD_SIZE  48
+
+/* Chunking parameters, the CDC_*_REG values latched by a start */
+typedef struct SHA256CdcParams {
+    uint32_t minSize;               // No cut point is looked for below it, at least 64
+    uint32_t avgSize;               // Normalization point between the two masks
+    uint32_t maxSize;               // Forced cut
+} SHA256CdcParams;
+
+/* Chunker state carried between the parts of a stream */
+typedef struct SHA256CdcState {
+    SHA256Context hash;             // Digest of the chunk in progress
+    uint64_t fingerprint;           // Gear hash of the chunk in progress
+    uint64_t offset;                // Stream offset of the chunk in progress
+    uint32_t length;                // Bytes of the chunk in progress
+} SHA256CdcState;
+
+/* MMIO Trace Capture ----------------------------------------------------------------- */
+
+/*
+ * Binary trace written when the "trace-file" property is set: one SHA256TraceHeader
+ * followed by SHA256TraceRecord entries, both in host byte order. Reads carry the value
+ * returned to the guest so a replay can check it.
+ */
+#define SHA256_TRACE_MAGIC      "S256TRC1"
+
+enum {
+    SHA256_TRACE_READ,              // addr, size, data = value returned
+    SHA256_TRACE_WRITE,             // addr, size, data = value written
+    SHA256_TRACE_JOB_DONE,          // addr = bank, size = 1 for a non-final part, data = bytes hashed
+};
+
+typedef struct SHA256TraceHeader {
+    char magic[8];
+    uint32_t inputSize;
+    uint32_t contexts;
+} SHA256TraceHeader;
+
+typedef struct SHA256TraceRecord {
+    uint64_t timeNs;                // QEMU_CLOCK_REALTIME
+    uint64_t data;
+    uint32_t addr;                  // Offset in the context's register page
+    uint16_t context;
+    uint8_t kind;
+    uint8_t size;
+} SHA256TraceRecord;
+
+typedef struct SHA256Trace {
+    FILE *file;
+    QemuMutex lock;                 // Records of all contexts go to one file
+} SHA256Trace;
+
+/* Statistics ------------------------------------------------------------------------ */
+
+/* Counters of one context, reported by query-sha256, "info sha256" and query-stats */
+typedef struct SHA256CoreStats {
+    uint64_t jobs;                  // Jobs completed, hash parts and key derivations
+    uint64_t bytes;                 // Input bytes of the completed jobs
+    uint64_t blocks;                // 64 byte blocks compressed, compress-on-write included
+    uint64_t busyNs;                // Time the worker spent on jobs
+    uint32_t queueDepth;            // Jobs queued or running, sampled by sha256_core_get_stats()
+} SHA256CoreStats;
+
+/* Register File ---------------------------------------------------------------------- */
+
+/* Key derivation parameters, the KDF_*_REG values latched by a start */
+typedef struct SHA256KdfParams {
+    uint32_t iterations;            // PBKDF2 iteration count
+    uint32_t keyLen;                // Password or input key bytes at the start of the bank
+    uint32_t saltLen;               // Salt bytes following the key
+    uint32_t infoLen;               // HKDF info bytes following the salt
+    uint32_t outLen;                // Derived key bytes
+} SHA256KdfParams;
+
+typedef enum {
+    BANK_IDLE,
+    BANK_BUSY,
+    BANK_DONE,
+} SHA256BankState;
+
+typedef struct SHA256Bank {
+    char *inputBuffer;              // Bank contents, inputSize bytes
+    uint32_t length;                // Value of LEN_REG for this bank
+    bool lengthValid;               // LEN_REG was written since the bank was last started
+    bool more;                      // Started with deviceMORE, do not finalize the message
+    uint32_t absorbed;              // Leading bytes of the job already absorbed by compress-on-write
+    uint32_t op;                    // Operation of the job, CTRL_OP of the start
+    SHA256KdfParams kdf;            // Parameters of a key derivation job
+    SHA256CdcParams cdc;            // Parameters of a chunking job
+    uint32_t cdcRecords;            // Records the last chunking job left in the bank, CDC_COUNT_REG
+    SHA256BankState state;
+} SHA256Bank;
+
+/* One register page (context): ping-pong banks, output register and the worker hashing them */
+typedef struct SHA256Core {
+    SHA256Bank banks[SHA256_NUM_BANKS];         // Ping-pong input banks, one is filled while the other is hashed
+    uint32_t fillBank;                          // Bank currently mapped into the input window
+    uint32_t inputSize;                         // Input window size in bytes
+    uint32_t queueCount;                        // Value of QUEUES_REG, set by the owning device
+    uint8_t outputBuffer[SHA256_DIGEST_SIZE];   // Buffer to store output SHA256 hash
+    uint32_t control;                           // Control register to start/stop and manage the device
+    uint32_t irqEnable;                         // Value of IRQ_REG
+    SHA256Context stream;                       // Running hash of the message spread over the banks
+    SHA256KdfParams kdf;                        // Values of the KDF_*_REG registers
+    SHA256CdcParams cdc;                        // Values of the CDC_*_REG registers
+    SHA256CdcState chunker;                     // Chunk in progress of the stream spread over the banks
+    uint8_t *resultBuffer;                      // Derived key or chunk records of the running job, inputSize bytes
+
+    /* Compress-on-write: complete blocks of the fill bank absorbed into stream while the context is idle */
+    SHA256Context eagerBase;                    // stream before the first absorbed block, restored on rollback
+    int eagerBank;                              // Bank with absorbed blocks, -1 for none
+    uint32_t eagerLen;                          // Bytes of eagerBank already in stream
+    uint32_t writtenLen[SHA256_NUM_BANKS];      // Prefix of each bank written in order since its last job
+    QEMUBH *notify;                             // Completion interrupt of the owning device, may be NULL
+    SHA256Trace *trace;                         // Access capture, NULL unless "trace-file" is set
+    uint16_t traceIndex;                        // Context number written to the trace, also its index in the monitor
+    SHA256CoreStats stats;
+    Object *owner;                              // Device the context belongs to, set by the device like trace
+    QTAILQ_ENTRY(SHA256Core) next;              // Registry of all cores, see sha256_core_foreach()
+
+    /* Worker thread hashing started banks in order, the vCPU returns as soon as a job is queued */
+    QemuThread worker;
+    QemuMutex lock;                             // Protects everything above against the worker
+    QemuCond jobCond;                           // Signalled when a job is queued or the device stops
+    QemuCond idleCond;                          // Signalled when the job queue drains
+    uint32_t jobQueue[SHA256_NUM_BANKS];
+    uint32_t jobHead;
+    uint32_t jobCount;
+    bool stopping;
+} SHA256Core;
+
+extern const MemoryRegionOps sha256_core_ops;
+
+extern const SHA256Backend sha256_backends[];
+extern const int sha256_backend_count;
+extern const SHA256Backend *sha256_active_backend;
+extern uint8_t digest[];
 
 /* Function prototypes */
-int perform_sha256_hashing(char *inputStr);
+int perform_sha256_hashing(char *inputStr, size_t inStrSize);
 void encodeMessageBlock(char* inStr, unsigned char messageBlock[], const int inSize, const int messageBlockSize);
 void messageSchedule(int chunkIndex, unsigned char** chunks, int numChunks, uint32_t w[]);
 void compression(uint32_t hashVal[], uint32_t w[]);
+bool sha256_select_backend(const char *name);
+void sha256_init(SHA256Context *ctx);
+void sha256_update(SHA256Context *ctx, const uint8_t *data, size_t len);
+void sha256_final(SHA256Context *ctx, uint8_t out[]);
+void sha256_pbkdf2(const uint8_t *password, size_t passwordLen, const uint8_t *salt, size_t saltLen,
+                   uint32_t iterations, uint8_t *out, size_t outLen);
+void sha256_hkdf(const uint8_t *key, size_t keyLen, const uint8_t *salt, size_t saltLen,
+                 const uint8_t *info, size_t infoLen, bool extract, uint8_t *out, size_t outLen);
+void sha256_cdc_init(SHA256CdcState *st);
+size_t sha256_cdc_update(SHA256CdcState *st, const SHA256CdcParams *p, const uint8_t *data, size_t len,
+                         bool final, uint8_t *records);
+bool sha256_core_check_input_size(uint32_t inputSize, Error **errp);
+uint64_t sha256_core_region_size(uint32_t inputSize);
+void sha256_core_init(SHA256Core *s, uint32_t inputSize, uint32_t queueCount, QEMUBH *notify);
+void sha256_core_cleanup(SHA256Core *s);
+void sha256_core_get_stats(SHA256Core *s, SHA256CoreStats *stats);
+void sha256_core_foreach(void (*fn)(SHA256Core *s, void *opaque), void *opaque);
+SHA256Trace *sha256_trace_open(const char *path, uint32_t inputSize, uint32_t contexts, Error **errp);
+void sha256_trace_close(SHA256Trace *trace);
 
 #endif
@@ -0,0 +1,230 @@
+/**
+ ****************************************************************************************
+ * @file    sha256_monitor.c
+ * @brief   Monitor interface of the SHA256 accelerators: the query-sha256 QMP command,
+ *          "info sha256" in HMP and a query-stats provider. Every sha256_device and
+ *          sha256-pci of the machine is reported with the counters of its contexts, and
+ *          every virtio-sha256-device with its virtqueue as a single context.
+ ****************************************************************************************
+ * @attention
+ * Build next to sha256_accelerator.c (hw/misc). sha256.json goes to qapi/, added to
+ * qapi/qapi-schema.json and to qapi_all_modules in qapi/meson.build. The other hooks
+ * are in files shared with the rest of QEMU:
+ *
+ *   qapi/stats.json            'sha256' in StatsProvider and in StatsTarget
+ *   include/monitor/hmp.h      void hmp_info_sha256(Monitor *mon, const QDict *qdict);
+ *   hmp-commands-info.hx       the entry below
+ *
+ *     {
+ *         .name       = "sha256",
+ *         .args_type  = "",
+ *         .params     = "",
+ *         .help       = "show SHA256 accelerator statistics",
+ *         .cmd        = hmp_info_sha256,
+ *     },
+ *
+ * query-stats reports each device under its QOM path, so "targets" selects devices and
+ * "names" selects counters, e.g.
+ *
+ *     { "execute": "query-stats", "arguments": { "target": "sha256" } }
+ */
+
+/* Includes -------------------------------------------------------------------------- */
+
+#include "qemu/osdep.h"
+#include "qapi/error.h"
+#include "qapi/qapi-commands-sha256.h"
+#include "qapi/qapi-commands-stats.h"
+#include "monitor/hmp.h"
+#include "monitor/monitor.h"
+#include "sysemu/stats.h"
+#include "qom/object.h"
+#include "hw/misc/sha256_accelerator.h"
+#include "hw/misc/virtio_sha256.h"
+
+/* QMP ------------------------------------------------------------------------------- */
+
+typedef struct {
+    Sha256DeviceInfoList *head;
+    Sha256DeviceInfoList **tail;
+    Sha256ContextInfoList **ctxTail;            // Contexts of the device being filled in
+    Sha256DeviceInfo *dev;
+    Object *owner;
+} SHA256Query;
+
+/* Starts the entry of a device, its contexts are added by sha256_query_context() */
+static void sha256_query_device(SHA256Query *q, Object *owner)
+{
+    q->owner = owner;
+    q->dev = g_new0(Sha256DeviceInfo, 1);
+    q->dev->qom_path = object_get_canonical_path(owner);
+    q->dev->type = g_strdup(object_get_typename(owner));
+    q->dev->backend = g_strdup(sha256_active_backend->name);
+    q->ctxTail = &q->dev->contexts;
+    QAPI_LIST_APPEND(q->tail, q->dev);
+}
+
+static void sha256_query_context(SHA256Query *q, uint32_t index, const SHA256CoreStats *stats)
+{
+    Sha256ContextInfo *ctx = g_new0(Sha256ContextInfo, 1);
+
+    ctx->index = index;
+    ctx->jobs = stats->jobs;
+    ctx->bytes = stats->bytes;
+    ctx->blocks = stats->blocks;
+    ctx->busy_ns = stats->busyNs;
+    ctx->queue_depth = stats->queueDepth;
+    QAPI_LIST_APPEND(q->ctxTail, ctx);
+
+    q->dev->jobs += stats->jobs;
+    q->dev->bytes += stats->bytes;
+    q->dev->blocks += stats->blocks;
+    q->dev->busy_ns += stats->busyNs;
+    q->dev->queue_depth += stats->queueDepth;
+}
+
+static void sha256_query_core(SHA256Core *core, void *opaque)
+{
+    SHA256Query *q = opaque;
+    SHA256CoreStats stats;
+
+    if (!core->owner) {
+        return;
+    }
+
+    // The contexts of a device are adjacent in the registry
+    if (core->owner != q->owner) {
+        sha256_query_device(q, core->owner);
+    }
+
+    sha256_core_get_stats(core, &stats);
+    sha256_query_context(q, core->traceIndex, &stats);
+}
+
+/* The virtio device hashes in its virtqueue handler, under the BQL like this command */
+static int sha256_query_virtio(Object *obj, void *opaque)
+{
+    VirtIOSHA256 *s = (VirtIOSHA256 *)object_dynamic_cast(obj, TYPE_VIRTIO_SHA256);
+
+    if (s) {
+        sha256_query_device(opaque, obj);
+        sha256_query_context(opaque, 0, &s->stats);
+    }
+    return 0;
+}
+
+Sha256DeviceInfoList *qmp_query_sha256(Error **errp)
+{
+    SHA256Query q = { 0 };
+
+    q.tail = &q.head;
+    sha256_core_foreach(sha256_query_core, &q);
+    object_child_foreach_recursive(object_get_root(), sha256_query_virtio, &q);
+    return q.head;
+}
+
+/* HMP ------------------------------------------------------------------------------- */
+
+void hmp_info_sha256(Monitor *mon, const QDict *qdict)
+{
+    g_autoptr(Sha256DeviceInfoList) devices = qmp_query_sha256(NULL);
+
+    if (!devices) {
+        monitor_printf(mon, "No SHA256 accelerator\n");
+        return;
+    }
+
+    for (Sha256DeviceInfoList *d = devices; d; d = d->next) {
+        Sha256DeviceInfo *dev = d->value;
+
+        monitor_printf(mon, "%s (%s, backend %s): %" PRIu64 " jobs, %" PRIu64 " bytes, %" PRIu64
+                       " blocks, busy %.3f ms, queue depth %u\n", dev->qom_path, dev->type, dev->backend,
+                       dev->jobs, dev->bytes, dev->blocks, dev->busy_ns / 1e6, dev->queue_depth);
+
+        // A single context would only repeat the totals
+        for (Sha256ContextInfoList *c = dev->contexts; c && dev->contexts->next; c = c->next) {
+            monitor_printf(mon, "  context %u: %" PRIu64 " jobs, %" PRIu64 " bytes, %" PRIu64
+                           " blocks, busy %.3f ms, queue depth %u\n", c->value->index, c->value->jobs,
+                           c->value->bytes, c->value->blocks, c->value->busy_ns / 1e6, c->value->queue_depth);
+        }
+    }
+}
+
+/* query-stats ----------------------------------------------------------------------- */
+
+static void sha256_add_stat(StatsList **list, strList *names, const char *name, uint64_t value)
+{
+    Stats *stat;
+
+    if (!apply_str_list_filter(name, names)) {
+        return;
+    }
+
+    stat = g_new0(Stats, 1);
+    stat->name = g_strdup(name);
+    stat->value = g_new0(StatsValue, 1);
+    stat->value->type = QTYPE_QNUM;
+    stat->value->u.scalar = value;
+    QAPI_LIST_PREPEND(*list, stat);
+}
+
+static void sha256_stats_cb(StatsResultList **result, StatsTarget target, strList *names,
+                            strList *targets, Error **errp)
+{
+    g_autoptr(Sha256DeviceInfoList) devices = NULL;
+
+    if (target != STATS_TARGET_SHA256) {
+        return;
+    }
+
+    devices = qmp_query_sha256(errp);
+    for (Sha256DeviceInfoList *d = devices; d; d = d->next) {
+        Sha256DeviceInfo *dev = d->value;
+        StatsList *stats = NULL;
+
+        if (!apply_str_list_filter(dev->qom_path, targets)) {
+            continue;
+        }
+        sha256_add_stat(&stats, names, "jobs", dev->jobs);
+        sha256_add_stat(&stats, names, "bytes", dev->bytes);
+        sha256_add_stat(&stats, names, "blocks", dev->blocks);
+        sha256_add_stat(&stats, names, "busy-ns", dev->busy_ns);
+        sha256_add_stat(&stats, names, "queue-depth", dev->queue_depth);
+        if (stats) {
+            add_stats_entry(result, STATS_PROVIDER_SHA256, dev->qom_path, stats);
+        }
+    }
+}
+
+static void sha256_add_schema(StatsSchemaValueList **list, const char *name, StatsType type,
+                              bool hasUnit, StatsUnit unit, int16_t exponent)
+{
+    StatsSchemaValue *value = g_new0(StatsSchemaValue, 1);
+
+    value->name = g_strdup(name);
+    value->type = type;
+    value->has_unit = hasUnit;
+    value->unit = unit;
+    value->base = 10;
+    value->exponent = exponent;
+    QAPI_LIST_PREPEND(*list, value);
+}
+
+static void sha256_schemas_cb(StatsSchemaList **result, Error **errp)
+{
+    StatsSchemaValueList *list = NULL;
+
+    sha256_add_schema(&list, "jobs", STATS_TYPE_CUMULATIVE, false, 0, 0);
+    sha256_add_schema(&list, "bytes", STATS_TYPE_CUMULATIVE, true, STATS_UNIT_BYTES, 0);
+    sha256_add_schema(&list, "blocks", STATS_TYPE_CUMULATIVE, false, 0, 0);
+    sha256_add_schema(&list, "busy-ns", STATS_TYPE_CUMULATIVE, true, STATS_UNIT_SECONDS, -9);
+    sha256_add_schema(&list, "queue-depth", STATS_TYPE_INSTANT, false, 0, 0);
+    add_stats_schema(result, STATS_PROVIDER_SHA256, STATS_TARGET_SHA256, list);
+}
+
+static void sha256_monitor_register(void)
+{
+    add_stats_callbacks(STATS_PROVIDER_SHA256, sha256_stats_cb, sha256_schemas_cb);
+}
+
+type_init(sha256_monitor_register)
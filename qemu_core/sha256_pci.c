@@ -0,0 +1,191 @@
+/**
+ ****************************************************************************************
+ * @file    sha256_pci.c
+ * @brief   PCI variant of the SHA256 Accelerator Core. BAR 0 holds one register page per
+ *          submission queue, laid out exactly like the sysbus device, and BAR 1 holds the
+ *          MSI-X table with one vector per queue.
+ ****************************************************************************************
+ * @attention
+ * Build next to sha256_accelerator.c (hw/misc) and instantiate with
+ * "-device sha256-pci,queues=4,input-size=4096" on any machine with a PCI(e) bus, e.g. the
+ * RISC-V virt machine or an x86 q35/pc machine.
+ */
+
+/* Includes -------------------------------------------------------------------------- */
+
+#include "qemu/osdep.h"
+#include "qapi/error.h"
+#include "qemu/main-loop.h"
+#include "qemu/module.h"
+#include "hw/pci/pci_device.h"
+#include "hw/pci/msix.h"
+#include "hw/qdev-properties.h"
+#include "hw/misc/sha256_accelerator.h"
+
+#define TYPE_SHA256_PCI "sha256-pci"
+typedef struct SHA256PCIState SHA256PCIState;
+DECLARE_INSTANCE_CHECKER(SHA256PCIState, SHA256_PCI, TYPE_SHA256_PCI)
+
+/* Device Macros Definitions --------------------------------------------------------- */
+
+#define SHA256_PCI_DEVICE_ID    0x5256          // Locally assigned under the QEMU vendor ID
+#define defaultQueues           4
+#define maxQueues               64
+#define defaultInputSize        1024
+#define regsBar                 0               // Register pages, queue i at i * stride
+#define msixBar                 1               // MSI-X table and PBA
+
+typedef struct SHA256PCIQueue {
+    SHA256PCIState *dev;
+    uint32_t index;                             // Queue number, also its MSI-X vector
+    SHA256Core core;
+    MemoryRegion iomem;
+    QEMUBH *bh;                                 // Raises the vector from the main loop
+} SHA256PCIQueue;
+
+struct SHA256PCIState {
+    PCIDevice parent_obj;
+    MemoryRegion bar;                           // Container for the per-queue register pages
+    SHA256PCIQueue *queues;
+    uint32_t numQueues;                         // "queues" property
+    uint32_t inputSize;                         // "input-size" property, shared by all queues
+    uint64_t queueStride;                       // Size of one register page
+    char *traceFile;                            // "trace-file" property, see SHA256TraceHeader
+    SHA256Trace *trace;
+};
+
+/* Interrupts ------------------------------------------------------------------------ */
+
+/* Completion of a job on a queue with irqDONE enabled, runs with the BQL held */
+static void sha256_pci_notify(void *opaque)
+{
+    SHA256PCIQueue *q = opaque;
+    PCIDevice *pdev = PCI_DEVICE(q->dev);
+
+    // Without MSI-X there is no per-queue line to raise, the driver polls STATUS_REG
+    if (msix_enabled(pdev)) {
+        msix_notify(pdev, q->index);
+    }
+}
+
+/* Device Modelling with QOM --------------------------------------------------------- */
+
+static void sha256_pci_free_queues(SHA256PCIState *s, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        SHA256PCIQueue *q = &s->queues[i];
+
+        // Join the worker first, it is the only one scheduling the bottom half
+        sha256_core_cleanup(&q->core);
+        qemu_bh_delete(q->bh);
+        memory_region_del_subregion(&s->bar, &q->iomem);
+        object_unparent(OBJECT(&q->iomem));
+    }
+    g_free(s->queues);
+    s->queues = NULL;
+
+    sha256_trace_close(s->trace);
+    s->trace = NULL;
+}
+
+static void sha256_pci_realize(PCIDevice *pdev, Error **errp)
+{
+    SHA256PCIState *s = SHA256_PCI(pdev);
+
+    if (!sha256_core_check_input_size(s->inputSize, errp)) {
+        return;
+    }
+
+    if (s->numQueues < 1 || s->numQueues > maxQueues) {
+        error_setg(errp, "sha256-pci: queues must be between 1 and %d", maxQueues);
+        return;
+    }
+
+    if (s->traceFile) {
+        s->trace = sha256_trace_open(s->traceFile, s->inputSize, s->numQueues, errp);
+        if (!s->trace) {
+            return;
+        }
+    }
+
+    s->queueStride = sha256_core_region_size(s->inputSize);
+    memory_region_init(&s->bar, OBJECT(s), "sha256-pci-regs", pow2ceil(s->numQueues * s->queueStride));
+
+    s->queues = g_new0(SHA256PCIQueue, s->numQueues);
+    for (uint32_t i = 0; i < s->numQueues; ++i) {
+        SHA256PCIQueue *q = &s->queues[i];
+        g_autofree char *name = g_strdup_printf("sha256-pci-queue%u", i);
+
+        q->dev = s;
+        q->index = i;
+        q->bh = qemu_bh_new_guarded(sha256_pci_notify, q, &DEVICE(s)->mem_reentrancy_guard);
+        sha256_core_init(&q->core, s->inputSize, s->numQueues, q->bh);
+        q->core.trace = s->trace;
+        q->core.traceIndex = i;
+        q->core.owner = OBJECT(s);
+
+        memory_region_init_io(&q->iomem, OBJECT(s), &sha256_core_ops, &q->core, name, s->queueStride);
+        memory_region_clear_global_locking(&q->iomem);    // The core has its own lock
+        memory_region_add_subregion(&s->bar, i * s->queueStride, &q->iomem);
+    }
+
+    pci_register_bar(pdev, regsBar, PCI_BASE_ADDRESS_SPACE_MEMORY | PCI_BASE_ADDRESS_MEM_TYPE_64, &s->bar);
+
+    if (msix_init_exclusive_bar(pdev, s->numQueues, msixBar, errp)) {
+        sha256_pci_free_queues(s, s->numQueues);
+        return;
+    }
+    for (uint32_t i = 0; i < s->numQueues; ++i) {
+        msix_vector_use(pdev, i);
+    }
+}
+
+static void sha256_pci_exit(PCIDevice *pdev)
+{
+    SHA256PCIState *s = SHA256_PCI(pdev);
+
+    msix_uninit_exclusive_bar(pdev);
+    sha256_pci_free_queues(s, s->numQueues);
+}
+
+static Property sha256_pci_properties[] = {
+    DEFINE_PROP_UINT32("queues", SHA256PCIState, numQueues, defaultQueues),
+    DEFINE_PROP_UINT32("input-size", SHA256PCIState, inputSize, defaultInputSize),
+    DEFINE_PROP_STRING("trace-file", SHA256PCIState, traceFile),
+    DEFINE_PROP_END_OF_LIST(),
+};
+
+static void sha256_pci_class_init(ObjectClass *klass, void *data)
+{
+    DeviceClass *dc = DEVICE_CLASS(klass);
+    PCIDeviceClass *k = PCI_DEVICE_CLASS(klass);
+
+    k->realize = sha256_pci_realize;
+    k->exit = sha256_pci_exit;
+    k->vendor_id = PCI_VENDOR_ID_QEMU;
+    k->device_id = SHA256_PCI_DEVICE_ID;
+    k->revision = 1;
+    k->class_id = PCI_CLASS_CRYPT_OTHER;
+
+    device_class_set_props(dc, sha256_pci_properties);
+    dc->desc = "SHA256 accelerator with MSI-X submission queues";
+    set_bit(DEVICE_CATEGORY_MISC, dc->categories);
+}
+
+static const TypeInfo sha256_pci_info = {
+    .name = TYPE_SHA256_PCI,
+    .parent = TYPE_PCI_DEVICE,
+    .instance_size = sizeof(SHA256PCIState),
+    .class_init = sha256_pci_class_init,
+    .interfaces = (InterfaceInfo[]) {
+        { INTERFACE_CONVENTIONAL_PCI_DEVICE },
+        { },
+    },
+};
+
+static void sha256_pci_register_types(void)
+{
+    type_register_static(&sha256_pci_info);
+}
+
+type_init(sha256_pci_register_types)
@@ -0,0 +1,350 @@
+/**
+ ****************************************************************************************
+ * @file    sha256-accelerator-test.c
+ * @brief   qtest suite for sha256_device: known-answer tests through the MMIO window and
+ *          a throughput measurement per access width. No guest kernel is booted, every
+ *          access is issued by the test over the qtest protocol.
+ ****************************************************************************************
+ * @attention
+ * Copy this file to tests/qtest/ of the QEMU tree and add it to the RISC-V list in
+ * tests/qtest/meson.build:
+ *
+ *     qtests_riscv64 = [..., 'sha256-accelerator-test']
+ *
+ * then run it with "make check-qtest-riscv64" or directly:
+ *
+ *     QTEST_QEMU_BINARY=./qemu-system-riscv64 ./tests/qtest/sha256-accelerator-test
+ *
+ * The base address of the accelerator is looked up in "info mtree", so the test follows
+ * wherever the virt machine maps it. Reference digests come from GLib's GChecksum. Pass
+ * "-m perf" for a longer throughput run and "-m slow" for the one million 'a' vector.
+ */
+
+/* Includes -------------------------------------------------------------------------- */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+
+/* Device Register Map --------------------------------------------------------------- */
+
+#define ID_REG          0x0000
+#define CAP_REG         0x0004
+#define CTRL_REG        0x0008
+#define STATUS_REG      0x000C
+#define INPUT_REG       0x0010
+#define OUTPUT_REG(t)   (INPUT_REG + (t)->inputSize)
+#define LEN_REG(t)      (OUTPUT_REG(t) + SHA256_DIGEST_SIZE)
+#define KDF_ITER_REG(t)     (LEN_REG(t) + 0x0C)
+#define KDF_KEYLEN_REG(t)   (LEN_REG(t) + 0x10)
+#define KDF_SALTLEN_REG(t)  (LEN_REG(t) + 0x14)
+#define KDF_INFOLEN_REG(t)  (LEN_REG(t) + 0x18)
+#define KDF_OUTLEN_REG(t)   (LEN_REG(t) + 0x1C)
+
+/* Device Macros Definitions --------------------------------------------------------- */
+
+#define deviceEN            0x00000001
+#define deviceBANK          0x00000002
+#define deviceMORE          0x00000004
+#define deviceSELECT        0x00000008
+#define deviceOP(op)        ((op) << 4)
+#define opPBKDF2            0x1
+#define opHKDF              0x2
+#define statusBUSY(bank)    (0x2 << ((bank) * 4))
+#define DEVICE_ID           0xFEEDCAFE
+#define SHA256_DIGEST_SIZE  32
+#define pollLimit           10000000        // STATUS_REG reads before a job is declared lost
+
+typedef struct {
+    QTestState *qts;
+    uint64_t base;                          // Guest physical address of the register page
+    uint32_t inputSize;
+} SHA256Test;
+
+/* FIPS 180-4 examples, published in the NIST CSRC "Examples with Intermediate Values" */
+static const struct {
+    const char *msg;
+    const char *digest;
+} fipsVectors[] = {
+    { "", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+    { "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+    { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+      "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+    { "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+      "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1" },
+};
+
+/* Padding boundaries (55/56/64), one byte short of the window and multi-part messages */
+static const size_t edgeLengths[] = { 0, 1, 55, 56, 63, 64, 65, 1023, 1024, 1025, 3000 };
+
+/* Helpers --------------------------------------------------------------------------- */
+
+/* Finds the start of the "sha256_device" container in the system memory tree */
+static bool find_device(QTestState *qts, uint64_t *base) {
+
+    g_autofree char *mtree = qtest_hmp(qts, "info mtree");
+    g_auto(GStrv) lines = g_strsplit(mtree, "\n", -1);
+
+    for (int i = 0; lines[i]; ++i) {
+        if (g_str_has_suffix(lines[i], ": sha256_device")) {
+            *base = g_ascii_strtoull(g_strchug(lines[i]), NULL, 16);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool sha256_test_start(SHA256Test *t) {
+
+    t->qts = qtest_init("-machine virt");
+    if (!find_device(t->qts, &t->base)) {
+        qtest_quit(t->qts);
+        g_test_skip("sha256_device is not mapped on this virt machine");
+        return false;
+    }
+
+    g_assert_cmphex(qtest_readl(t->qts, t->base + ID_REG), ==, DEVICE_ID);
+    t->inputSize = qtest_readl(t->qts, t->base + CAP_REG);
+    g_assert_cmpuint(t->inputSize, >=, 64);
+
+    qtest_writel(t->qts, t->base + CTRL_REG, 0);                        // Reset
+    return true;
+}
+
+static void wait_bank(SHA256Test *t, int bank) {
+
+    for (long i = 0; i < pollLimit; ++i) {
+        if (!(qtest_readl(t->qts, t->base + STATUS_REG) & statusBUSY(bank))) {
+            return;
+        }
+    }
+    g_assert_not_reached();
+}
+
+/* Stores len bytes at addr with accesses of the given width, LSB first like the device */
+static void write_window(SHA256Test *t, uint64_t addr, const uint8_t *data, size_t len, unsigned width) {
+
+    for (size_t i = 0; i < len; i += width) {
+        uint32_t word = 0;
+
+        memcpy(&word, data + i, MIN(len - i, width));
+        switch (width) {
+            case 1:
+                qtest_writeb(t->qts, addr + i, word);
+                break;
+            case 2:
+                qtest_writew(t->qts, addr + i, word);
+                break;
+            default:
+                qtest_writel(t->qts, addr + i, word);
+                break;
+        }
+    }
+}
+
+/* Streams the message over both banks and returns the digest as lowercase hex */
+static char *mmio_digest(SHA256Test *t, const uint8_t *msg, size_t len, unsigned width) {
+
+    char *hex = g_malloc(2 * SHA256_DIGEST_SIZE + 1);
+    int bank = 0;
+    size_t off = 0;
+
+    do {
+        size_t n = MIN(len - off, t->inputSize);
+        bool more = off + n < len;
+
+        wait_bank(t, bank);
+        qtest_writel(t->qts, t->base + CTRL_REG, deviceSELECT | (bank ? deviceBANK : 0));
+        write_window(t, t->base + INPUT_REG, msg + off, n, width);
+        qtest_writel(t->qts, t->base + LEN_REG(t), n);
+        qtest_writel(t->qts, t->base + CTRL_REG, deviceEN | (bank ? deviceBANK : 0) | (more ? deviceMORE : 0));
+
+        off += n;
+        bank ^= 1;
+    } while (off < len);
+    wait_bank(t, bank ^ 1);
+
+    for (int i = 0; i < SHA256_DIGEST_SIZE; ++i) {
+        sprintf(hex + 2 * i, "%02x", qtest_readb(t->qts, t->base + OUTPUT_REG(t) + i));
+    }
+    return hex;
+}
+
+/* Message bytes that cover the whole 0x00-0xFF range */
+static uint8_t *pattern(size_t len) {
+
+    uint8_t *buf = g_malloc(len + 1);
+
+    for (size_t i = 0; i < len; ++i) {
+        buf[i] = (i * 131 + 7) & 0xFF;
+    }
+    return buf;
+}
+
+/* Tests ----------------------------------------------------------------------------- */
+
+static void test_fips_vectors(void) {
+
+    SHA256Test t;
+
+    if (!sha256_test_start(&t)) {
+        return;
+    }
+
+    for (size_t i = 0; i < G_N_ELEMENTS(fipsVectors); ++i) {
+        g_autofree char *hex = mmio_digest(&t, (const uint8_t *)fipsVectors[i].msg,
+                                           strlen(fipsVectors[i].msg), 4);
+        g_assert_cmpstr(hex, ==, fipsVectors[i].digest);
+    }
+
+    if (g_test_slow()) {
+        g_autofree uint8_t *million = g_malloc(1000000);
+        g_autofree char *hex = NULL;
+
+        memset(million, 'a', 1000000);
+        hex = mmio_digest(&t, million, 1000000, 4);
+        g_assert_cmpstr(hex, ==, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+    }
+
+    qtest_quit(t.qts);
+}
+
+static void test_edge_lengths(void) {
+
+    SHA256Test t;
+
+    if (!sha256_test_start(&t)) {
+        return;
+    }
+
+    for (size_t i = 0; i < G_N_ELEMENTS(edgeLengths); ++i) {
+        g_autofree uint8_t *msg = pattern(edgeLengths[i]);
+        g_autofree char *expected = g_compute_checksum_for_data(G_CHECKSUM_SHA256, msg, edgeLengths[i]);
+
+        for (unsigned width = 1; width <= 4; width <<= 1) {
+            g_autofree char *hex = mmio_digest(&t, msg, edgeLengths[i], width);
+
+            if (strcmp(hex, expected) != 0) {
+                g_test_message("%zu bytes with %u-byte writes", edgeLengths[i], width);
+            }
+            g_assert_cmpstr(hex, ==, expected);
+        }
+    }
+
+    qtest_quit(t.qts);
+}
+
+/* Bytes >= 0x80 read back from the window must not be sign-extended */
+static void test_window_readback(void) {
+
+    SHA256Test t;
+    uint64_t in;
+
+    if (!sha256_test_start(&t)) {
+        return;
+    }
+    in = t.base + INPUT_REG;
+
+    qtest_writel(t.qts, in, 0x80fffe7f);
+    g_assert_cmphex(qtest_readb(t.qts, in + 0), ==, 0x7f);
+    g_assert_cmphex(qtest_readb(t.qts, in + 1), ==, 0xfe);
+    g_assert_cmphex(qtest_readw(t.qts, in + 2), ==, 0x80ff);
+    g_assert_cmphex(qtest_readl(t.qts, in), ==, 0x80fffe7f);
+
+    qtest_quit(t.qts);
+}
+
+/* Runs one key derivation on bank 0, returns the derived key as lowercase hex */
+static char *mmio_derive(SHA256Test *t, uint32_t op, const char *key, const char *salt, const char *info,
+                         uint32_t iterations, size_t outLen) {
+
+    g_autofree char *msg = g_strconcat(key, salt, info, NULL);
+    char *hex = g_malloc(2 * outLen + 1);
+
+    qtest_writel(t->qts, t->base + CTRL_REG, 0);
+    write_window(t, t->base + INPUT_REG, (const uint8_t *)msg, strlen(msg), 1);
+    qtest_writel(t->qts, t->base + KDF_ITER_REG(t), iterations);
+    qtest_writel(t->qts, t->base + KDF_KEYLEN_REG(t), strlen(key));
+    qtest_writel(t->qts, t->base + KDF_SALTLEN_REG(t), strlen(salt));
+    qtest_writel(t->qts, t->base + KDF_INFOLEN_REG(t), strlen(info));
+    qtest_writel(t->qts, t->base + KDF_OUTLEN_REG(t), outLen);
+    qtest_writel(t->qts, t->base + CTRL_REG, deviceEN | deviceOP(op));
+    wait_bank(t, 0);
+
+    for (size_t i = 0; i < outLen; ++i) {
+        sprintf(hex + 2 * i, "%02x", qtest_readb(t->qts, t->base + INPUT_REG + i));
+    }
+    return hex;
+}
+
+/* PBKDF2 vector of RFC 7914 section 11, HKDF extract and expand over printable inputs */
+static void test_key_derivation(void) {
+
+    SHA256Test t;
+    g_autofree char *pbkdf2 = NULL;
+    g_autofree char *hkdf = NULL;
+
+    if (!sha256_test_start(&t)) {
+        return;
+    }
+
+    pbkdf2 = mmio_derive(&t, opPBKDF2, "passwd", "salt", "", 1, 64);
+    g_assert_cmpstr(pbkdf2, ==, "55ac046e56e3089fec1691c22544b605f94185216dde0465e68b9d57c20dacbc"
+                                "49ca9cccf179b645991664b39d77ef317c71b845b1e30bd509112041d3a19783");
+
+    hkdf = mmio_derive(&t, opHKDF, "input key", "salt", "context", 0, 42);
+    g_assert_cmpstr(hkdf, ==, "49060e83486a86844130609b08a2c02c6cfa73da49186bdde0d795751113ae0e2e27096b6f4d06744091");
+
+    qtest_quit(t.qts);
+}
+
+/* MB/s of the input window per access width, and of complete digests per width */
+static void test_throughput(void) {
+
+    SHA256Test t;
+    int windows = g_test_perf() ? 1024 : 16;
+    g_autofree uint8_t *msg = NULL;
+
+    if (!sha256_test_start(&t)) {
+        return;
+    }
+    msg = pattern(t.inputSize);
+
+    for (unsigned width = 1; width <= 4; width <<= 1) {
+        double fill, hash;
+
+        g_test_timer_start();
+        for (int i = 0; i < windows; ++i) {
+            write_window(&t, t.base + INPUT_REG, msg, t.inputSize, width);
+        }
+        fill = g_test_timer_elapsed();
+
+        g_test_timer_start();
+        for (int i = 0; i < windows; ++i) {
+            g_free(mmio_digest(&t, msg, t.inputSize, width));
+        }
+        hash = g_test_timer_elapsed();
+
+        g_test_message("%u-byte accesses: window fill %.2f MB/s, digest %.2f MB/s", width,
+                       windows * (double)t.inputSize / fill / 1e6,
+                       windows * (double)t.inputSize / hash / 1e6);
+    }
+
+    qtest_quit(t.qts);
+}
+
+int main(int argc, char **argv) {
+
+    g_test_init(&argc, &argv, NULL);
+
+    if (strcmp(qtest_get_arch(), "riscv64") && strcmp(qtest_get_arch(), "riscv32")) {
+        return g_test_run();
+    }
+
+    qtest_add_func("/sha256/fips-vectors", test_fips_vectors);
+    qtest_add_func("/sha256/edge-lengths", test_edge_lengths);
+    qtest_add_func("/sha256/window-readback", test_window_readback);
+    qtest_add_func("/sha256/key-derivation", test_key_derivation);
+    qtest_add_func("/sha256/throughput", test_throughput);
+
+    return g_test_run();
+}
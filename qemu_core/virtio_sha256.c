@@ -0,0 +1,206 @@
+/**
+ ****************************************************************************************
+ * @file    virtio_sha256.c
+ * @brief   This file implements a virtio transport for the SHA256 Accelerator Core. Each
+ *          request on the virtqueue carries a whole message as a scatter-gather list and
+ *          is hashed straight out of guest memory with the core of sha256_accelerator.c.
+ ****************************************************************************************
+ * @attention
+ * Build next to sha256_accelerator.c (hw/misc), the header goes to include/hw/misc/.
+ * The device plugs into any virtio bus, e.g. "-device virtio-sha256-device" on a
+ * virtio-mmio slot of the RISC-V virt machine or "-device virtio-sha256-pci".
+ */
+
+/* Includes -------------------------------------------------------------------------- */
+
+#include "qemu/osdep.h"
+#include "qemu/iov.h"
+#include "qemu/log.h"
+#include "qemu/timer.h"
+#include "qapi/error.h"
+#include "hw/qdev-properties.h"
+#include "hw/virtio/virtio.h"
+#include "migration/vmstate.h"
+#include "hw/misc/sha256_accelerator.h"
+#include "hw/misc/virtio_sha256.h"
+
+/* Device Macros Definitions --------------------------------------------------------- */
+
+#define defaultQueueSize    256
+#define maxQueueSize        1024
+
+/* Request Processing ---------------------------------------------------------------- */
+
+/**
+ * @brief Hashes one request. The message segments are mapped guest memory, so they are
+ * fed to the streaming core in place without an intermediate copy.
+ *
+ * @return returns the number of bytes written to the in descriptors, or 0 on a framing
+ * error after which the device is marked broken.
+ */
+
+static size_t virtio_sha256_process(VirtIOSHA256 *s, VirtQueueElement *elem)
+{
+    VirtIODevice *vdev = VIRTIO_DEVICE(s);
+    struct virtio_sha256_req_hdr hdr;
+    struct virtio_sha256_resp resp = { .status = VIRTIO_SHA256_S_OK };
+    SHA256Context ctx;
+    size_t skip = sizeof(hdr);
+    uint64_t len = 0;
+    int64_t start;
+
+    if (elem->out_num < 1 || elem->in_num < 1 ||
+        iov_size(elem->in_sg, elem->in_num) < sizeof(resp)) {
+        virtio_error(vdev, "virtio-sha256: request without header or response buffer");
+        return 0;
+    }
+
+    if (iov_to_buf(elem->out_sg, elem->out_num, 0, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+        virtio_error(vdev, "virtio-sha256: request header too short");
+        return 0;
+    }
+
+    if (le32_to_cpu(hdr.type) != VIRTIO_SHA256_T_DIGEST) {
+        qemu_log_mask(LOG_GUEST_ERROR, "virtio-sha256: unsupported request type %u\n", le32_to_cpu(hdr.type));
+        resp.status = VIRTIO_SHA256_S_UNSUPP;
+    } else {
+        start = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+        sha256_init(&ctx);
+        for (unsigned int i = 0; i < elem->out_num; ++i) {
+            const uint8_t *base = elem->out_sg[i].iov_base;
+            size_t segLen = elem->out_sg[i].iov_len;
+
+            // The header may share the first segment with the message
+            if (skip >= segLen) {
+                skip -= segLen;
+                continue;
+            }
+            sha256_update(&ctx, base + skip, segLen - skip);
+            len += segLen - skip;
+            skip = 0;
+        }
+        sha256_final(&ctx, resp.digest);
+        s->stats.bytes += len;
+        s->stats.blocks += (len + 8) / 64 + 1;          // Padding and length included
+        s->stats.busyNs += qemu_clock_get_ns(QEMU_CLOCK_REALTIME) - start;
+    }
+
+    s->stats.jobs++;
+    return iov_from_buf(elem->in_sg, elem->in_num, 0, &resp, sizeof(resp));
+}
+
+/* Virtqueue handler: drains every available request with guest notifications off */
+static void virtio_sha256_handle_request(VirtIODevice *vdev, VirtQueue *vq)
+{
+    VirtIOSHA256 *s = VIRTIO_SHA256(vdev);
+    VirtQueueElement *elem;
+    bool completed = false;
+
+    do {
+        virtio_queue_set_notification(vq, 0);
+
+        while ((elem = virtqueue_pop(vq, sizeof(VirtQueueElement)))) {
+            size_t written = virtio_sha256_process(s, elem);
+
+            if (written == 0) {
+                virtqueue_detach_element(vq, elem, 0);
+                g_free(elem);
+                return;
+            }
+            virtqueue_push(vq, elem, written);
+            g_free(elem);
+            completed = true;
+        }
+
+        virtio_queue_set_notification(vq, 1);
+    } while (!virtio_queue_empty(vq));
+
+    // A single interrupt for the whole batch, subject to the driver's event index
+    if (completed) {
+        virtio_notify(vdev, vq);
+    }
+}
+
+/* Device Modelling with QOM --------------------------------------------------------- */
+
+static void virtio_sha256_get_config(VirtIODevice *vdev, uint8_t *config)
+{
+    VirtIOSHA256 *s = VIRTIO_SHA256(vdev);
+    struct virtio_sha256_config cfg;
+
+    // Leave room for the header and the response descriptors
+    stl_le_p(&cfg.max_segments, s->queueSize - 2);
+    memcpy(config, &cfg, sizeof(cfg));
+}
+
+static uint64_t virtio_sha256_get_features(VirtIODevice *vdev, uint64_t features, Error **errp)
+{
+    return features;
+}
+
+static void virtio_sha256_device_realize(DeviceState *dev, Error **errp)
+{
+    VirtIODevice *vdev = VIRTIO_DEVICE(dev);
+    VirtIOSHA256 *s = VIRTIO_SHA256(dev);
+
+    if (s->queueSize < 4 || s->queueSize > maxQueueSize || (s->queueSize & (s->queueSize - 1))) {
+        error_setg(errp, "virtio-sha256: queue-size must be a power of 2 between 4 and %d", maxQueueSize);
+        return;
+    }
+
+    virtio_init(vdev, VIRTIO_ID_SHA256, sizeof(struct virtio_sha256_config));
+    s->vq = virtio_add_queue(vdev, s->queueSize, virtio_sha256_handle_request);
+}
+
+static void virtio_sha256_device_unrealize(DeviceState *dev)
+{
+    VirtIODevice *vdev = VIRTIO_DEVICE(dev);
+    VirtIOSHA256 *s = VIRTIO_SHA256(dev);
+
+    virtio_delete_queue(s->vq);
+    virtio_cleanup(vdev);
+}
+
+static const VMStateDescription vmstate_virtio_sha256 = {
+    .name = "virtio-sha256",
+    .minimum_version_id = 1,
+    .version_id = 1,
+    .fields = (VMStateField[]) {
+        VMSTATE_VIRTIO_DEVICE,
+        VMSTATE_END_OF_LIST()
+    },
+};
+
+static Property virtio_sha256_properties[] = {
+    DEFINE_PROP_UINT32("queue-size", VirtIOSHA256, queueSize, defaultQueueSize),
+    DEFINE_PROP_END_OF_LIST(),
+};
+
+static void virtio_sha256_class_init(ObjectClass *klass, void *data)
+{
+    DeviceClass *dc = DEVICE_CLASS(klass);
+    VirtioDeviceClass *vdc = VIRTIO_DEVICE_CLASS(klass);
+
+    device_class_set_props(dc, virtio_sha256_properties);
+    dc->vmsd = &vmstate_virtio_sha256;
+    set_bit(DEVICE_CATEGORY_MISC, dc->categories);
+
+    vdc->realize = virtio_sha256_device_realize;
+    vdc->unrealize = virtio_sha256_device_unrealize;
+    vdc->get_config = virtio_sha256_get_config;
+    vdc->get_features = virtio_sha256_get_features;
+}
+
+static const TypeInfo virtio_sha256_info = {
+    .name = TYPE_VIRTIO_SHA256,
+    .parent = TYPE_VIRTIO_DEVICE,
+    .instance_size = sizeof(VirtIOSHA256),
+    .class_init = virtio_sha256_class_init,
+};
+
+static void virtio_sha256_register_types(void)
+{
+    type_register_static(&virtio_sha256_info);
+}
+
+type_init(virtio_sha256_register_types)
@@ -0,0 +1,42 @@
+#ifndef HW_VIRTIO_SHA256_H
+#define HW_VIRTIO_SHA256_H
+
+#include "hw/virtio/virtio.h"
+#include "hw/misc/sha256_accelerator.h"
+#include "qom/object.h"
+
+#define TYPE_VIRTIO_SHA256 "virtio-sha256-device"
+OBJECT_DECLARE_SIMPLE_TYPE(VirtIOSHA256, VIRTIO_SHA256)
+
+/* Locally assigned device ID, not registered with the virtio specification */
+#define VIRTIO_ID_SHA256            63
+
+/* Request layout: out = header + message segments, in = response */
+#define VIRTIO_SHA256_T_DIGEST      0
+
+#define VIRTIO_SHA256_S_OK          0
+#define VIRTIO_SHA256_S_IOERR       1
+#define VIRTIO_SHA256_S_UNSUPP      2
+
+struct virtio_sha256_req_hdr {
+    uint32_t type;                  // VIRTIO_SHA256_T_*, little endian
+    uint32_t reserved;
+};
+
+struct virtio_sha256_resp {
+    uint8_t digest[32];
+    uint8_t status;                 // VIRTIO_SHA256_S_*
+};
+
+struct virtio_sha256_config {
+    uint32_t max_segments;          // Largest number of message segments per request
+};
+
+struct VirtIOSHA256 {
+    VirtIODevice parent_obj;
+    VirtQueue *vq;
+    uint32_t queueSize;             // "queue-size" property
+    SHA256CoreStats stats;          // Jobs are completed requests, reported by sha256_monitor.c
+};
+
+#endif
@@ -0,0 +1,68 @@
+/**
+ ****************************************************************************************
+ * @file    virtio_sha256_pci.c
+ * @brief   virtio-pci proxy for the virtio SHA256 device, for machines with a PCI bus.
+ ****************************************************************************************
+ */
+
+/* Includes -------------------------------------------------------------------------- */
+
+#include "qemu/osdep.h"
+#include "qapi/error.h"
+#include "qemu/module.h"
+#include "hw/virtio/virtio-pci.h"
+#include "hw/misc/virtio_sha256.h"
+
+typedef struct VirtIOSHA256PCI VirtIOSHA256PCI;
+
+#define TYPE_VIRTIO_SHA256_PCI "virtio-sha256-pci-base"
+DECLARE_INSTANCE_CHECKER(VirtIOSHA256PCI, VIRTIO_SHA256_PCI, TYPE_VIRTIO_SHA256_PCI)
+
+struct VirtIOSHA256PCI {
+    VirtIOPCIProxy parent_obj;
+    VirtIOSHA256 vdev;
+};
+
+static void virtio_sha256_pci_realize(VirtIOPCIProxy *vpci_dev, Error **errp)
+{
+    VirtIOSHA256PCI *dev = VIRTIO_SHA256_PCI(vpci_dev);
+    DeviceState *vdev = DEVICE(&dev->vdev);
+
+    // Device ID 63 has no legacy interface, a transitional proxy would refuse to realize
+    virtio_pci_force_virtio_1(vpci_dev);
+    qdev_realize(vdev, BUS(&vpci_dev->bus), errp);
+}
+
+static void virtio_sha256_pci_class_init(ObjectClass *klass, void *data)
+{
+    DeviceClass *dc = DEVICE_CLASS(klass);
+    VirtioPCIClass *k = VIRTIO_PCI_CLASS(klass);
+    PCIDeviceClass *pcidev_k = PCI_DEVICE_CLASS(klass);
+
+    k->realize = virtio_sha256_pci_realize;
+    set_bit(DEVICE_CATEGORY_MISC, dc->categories);
+
+    pcidev_k->class_id = PCI_CLASS_OTHERS;
+}
+
+static void virtio_sha256_pci_instance_init(Object *obj)
+{
+    VirtIOSHA256PCI *dev = VIRTIO_SHA256_PCI(obj);
+
+    virtio_instance_init_common(obj, &dev->vdev, sizeof(dev->vdev), TYPE_VIRTIO_SHA256);
+}
+
+static const VirtioPCIDeviceTypeInfo virtio_sha256_pci_info = {
+    .base_name = TYPE_VIRTIO_SHA256_PCI,
+    .generic_name = "virtio-sha256-pci",
+    .instance_size = sizeof(VirtIOSHA256PCI),
+    .instance_init = virtio_sha256_pci_instance_init,
+    .class_init = virtio_sha256_pci_class_init,
+};
+
+static void virtio_sha256_pci_register(void)
+{
+    virtio_pci_types_register(&virtio_sha256_pci_info);
+}
+
+type_init(virtio_sha256_pci_register)
@@ -0,0 +1,173 @@
+/**
+ ****************************************************************************************
+ * @file    sha256_crossover.c
+ * @brief   Finds the message size from which the accelerator behind sha_driver.ko beats
+ *          hashing on the vCPU. Every software backend of sha256_sw.c (the lab1 scalar
+ *          loops, Zknh and Zvknha) and the character device are timed per digest over a
+ *          range of message sizes.
+ ****************************************************************************************
+ * @attention
+ * Usage: sha256_crossover [--chardev /dev/sha2560] [--sizes 16,64,256] [--iterations N]
+ *
+ * The device path is one write, SHA256_IOC_START_HASH and one read per digest, like the
+ * lab5 tools. The software backends hash each size as one sha256_sw_batch() of
+ * --iterations messages. The digest cache of the driver is switched off for the file, otherwise the
+ * repeated message would never reach the device, and so is its software fallback below the
+ * crossover found at probe. Without the device only the software numbers are printed.
+ */
+
+/* Includes -------------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+#include "sha256_sw.h"
+
+#define SHA256_IOC_MAGIC 'k'
+#define SHA256_IOC_START_HASH _IOW(SHA256_IOC_MAGIC, 2, int)
+#define SHA256_IOC_SET_CACHE _IOW(SHA256_IOC_MAGIC, 6, int)
+#define SHA256_IOC_SET_FALLBACK _IOW(SHA256_IOC_MAGIC, 7, int)
+
+#define maxSizes            16
+#define defaultIterations   2000
+
+static const char *swBackends[] = { "portable", "zknh", "zvknha" };
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int chardev_digest(int fd, const char *msg, size_t len, uint8_t out[SHA256_SW_DIGEST_SIZE]) {
+
+    if (write(fd, msg, len) != (ssize_t)len)
+        return -1;
+    if (ioctl(fd, SHA256_IOC_START_HASH, NULL) == -1)
+        return -1;
+    return read(fd, out, SHA256_SW_DIGEST_SIZE) == SHA256_SW_DIGEST_SIZE ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+
+    const char *charPath = "/dev/sha2560";
+    size_t sizes[maxSizes] = { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 16384, 65536 };
+    int numSizes = 11, iterations = defaultIterations;
+    int numBackends = sizeof(swBackends) / sizeof(swBackends[0]);
+    int usable[sizeof(swBackends) / sizeof(swBackends[0])];
+    uint8_t devOut[SHA256_SW_DIGEST_SIZE];
+    uint8_t (*swOut)[SHA256_SW_DIGEST_SIZE];
+    const void **msgs;
+    size_t *lens;
+    size_t crossover = 0;
+    int fd;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--chardev") && i + 1 < argc) {
+            charPath = argv[++i];
+        } else if (!strcmp(argv[i], "--iterations") && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--sizes") && i + 1 < argc) {
+            char *tok = strtok(argv[++i], ",");
+            for (numSizes = 0; tok && numSizes < maxSizes; tok = strtok(NULL, ","))
+                sizes[numSizes++] = strtoul(tok, NULL, 0);
+        } else {
+            fprintf(stderr, "usage: %s [--chardev path] [--sizes a,b,...] [--iterations N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (iterations < 1 || numSizes < 1) {
+        fprintf(stderr, "%s: nothing to measure\n", argv[0]);
+        return 1;
+    }
+
+    msgs = malloc(iterations * sizeof(*msgs));
+    lens = malloc(iterations * sizeof(*lens));
+    swOut = malloc(iterations * sizeof(*swOut));
+
+    fd = open(charPath, O_RDWR);
+    if (fd < 0)
+        fprintf(stderr, "chardev: %s not available (%s)\n", charPath, strerror(errno));
+    else {
+        ioctl(fd, SHA256_IOC_SET_CACHE, 0);     // Older drivers have neither
+        ioctl(fd, SHA256_IOC_SET_FALLBACK, 0);
+    }
+
+    printf("%8s", "bytes");
+    for (int b = 0; b < numBackends; b++) {
+        usable[b] = sha256_sw_select(swBackends[b]) == 0;
+        if (usable[b])
+            printf(" %11s ns", swBackends[b]);
+    }
+    printf(" %11s ns\n", "device");
+
+    for (int s = 0; s < numSizes; s++) {
+        char *msg = malloc(sizes[s] ? sizes[s] : 1);
+        double best = 0, devNs = 0, t0;
+
+        for (size_t i = 0; i < sizes[s]; i++)
+            msg[i] = 'a' + (i % 26);
+        for (int i = 0; i < iterations; i++) {
+            msgs[i] = msg;
+            lens[i] = sizes[s];
+        }
+
+        printf("%8zu", sizes[s]);
+        for (int b = 0; b < numBackends; b++) {
+            double ns;
+
+            if (!usable[b])
+                continue;
+            sha256_sw_select(swBackends[b]);
+            t0 = now_ns();
+            sha256_sw_batch(msgs, lens, swOut, iterations);
+            ns = (now_ns() - t0) / iterations;
+            if (best == 0 || ns < best)
+                best = ns;
+            printf(" %14.0f", ns);
+        }
+
+        if (fd >= 0) {
+            t0 = now_ns();
+            for (int i = 0; i < iterations; i++) {
+                if (chardev_digest(fd, msg, sizes[s], devOut)) {
+                    perror("chardev digest");
+                    return 1;
+                }
+            }
+            devNs = (now_ns() - t0) / iterations;
+            if (memcmp(swOut[0], devOut, SHA256_SW_DIGEST_SIZE)) {
+                fprintf(stderr, "digest mismatch between software and device for %zu bytes\n", sizes[s]);
+                return 2;
+            }
+            printf(" %14.0f\n", devNs);
+
+            // First size from which the device stays ahead of the fastest software backend
+            if (devNs < best && !crossover)
+                crossover = sizes[s];
+            else if (devNs >= best)
+                crossover = 0;
+        } else {
+            printf(" %14s\n", "n/a");
+        }
+        free(msg);
+    }
+
+    if (fd >= 0) {
+        if (crossover)
+            printf("crossover: the device is faster from %zu bytes\n", crossover);
+        else
+            printf("crossover: software is faster at the largest measured size\n");
+        close(fd);
+    }
+    free(swOut);
+    free(lens);
+    free(msgs);
+    return 0;
+}
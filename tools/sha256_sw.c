@@ -0,0 +1,347 @@
+/**
+ ****************************************************************************************
+ * @file    sha256_sw.c
+ * @brief   Streaming software SHA-256 built from the message schedule and compression
+ *          loop of the lab1 reference implementation.
+ ****************************************************************************************
+ * @attention
+ * When built with -march=..._zknh (see the Makefile) a second backend runs the same loops
+ * on the Zknh sha256sig0/sig1/sum0/sum1 instructions, and RISC-V builds link the vector
+ * crypto kernel of sha256_zvknha.c as a third. A backend is only picked if the kernel
+ * reports its extensions through riscv_hwprobe, so the binary still runs on cores
+ * without them.
+ */
+
+/* Includes -------------------------------------------------------------------------- */
+
+#include <string.h>
+
+#include "sha256_sw.h"
+
+#if defined(__riscv) && defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#define HAVE_HWPROBE 1
+#else
+#define HAVE_HWPROBE 0
+#endif
+
+#if HAVE_HWPROBE && defined(__riscv_zknh)
+#define HAVE_ZKNH 1
+#else
+#define HAVE_ZKNH 0
+#endif
+
+#if HAVE_HWPROBE && defined(SHA256_SW_ZVKNHA)
+#define HAVE_ZVKNHA 1
+#else
+#define HAVE_ZVKNHA 0
+#endif
+
+#define RIGHT_ROTATE(value, n) (((value) >> (n)) | ((value) << (32 - (n))))
+
+static const uint32_t k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t initialHashVal[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+/* Compression ----------------------------------------------------------------------- */
+
+static void messageSchedule(const uint8_t *chunk, uint32_t w[64]) {
+
+    for (int i = 0; i < 16; ++i) {
+        w[i] = ((uint32_t)chunk[i * 4] << 24) | ((uint32_t)chunk[i * 4 + 1] << 16) |
+               ((uint32_t)chunk[i * 4 + 2] << 8) | (uint32_t)chunk[i * 4 + 3];
+    }
+
+    for (int i = 16; i < 64; ++i) {
+        uint32_t sigma0 = RIGHT_ROTATE(w[i - 15], 7) ^ RIGHT_ROTATE(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t sigma1 = RIGHT_ROTATE(w[i - 2], 17) ^ RIGHT_ROTATE(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + sigma0 + w[i - 7] + sigma1;
+    }
+}
+
+static void compression(uint32_t hashVal[8], const uint32_t w[64]) {
+
+    uint32_t a = hashVal[0], b = hashVal[1], c = hashVal[2], d = hashVal[3];
+    uint32_t e = hashVal[4], f = hashVal[5], g = hashVal[6], h = hashVal[7];
+
+    for (int i = 0; i < 64; ++i) {
+        uint32_t sumA = RIGHT_ROTATE(e, 6) ^ RIGHT_ROTATE(e, 11) ^ RIGHT_ROTATE(e, 25);
+        uint32_t choice = (e & f) ^ (~e & g);
+        uint32_t temp1 = h + sumA + choice + k[i] + w[i];
+        uint32_t sumE = RIGHT_ROTATE(a, 2) ^ RIGHT_ROTATE(a, 13) ^ RIGHT_ROTATE(a, 22);
+        uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t temp2 = sumE + majority;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+
+    hashVal[0] += a;
+    hashVal[1] += b;
+    hashVal[2] += c;
+    hashVal[3] += d;
+    hashVal[4] += e;
+    hashVal[5] += f;
+    hashVal[6] += g;
+    hashVal[7] += h;
+}
+
+static void portable_process_blocks(uint32_t hashVal[8], const uint8_t *data, size_t blocks) {
+
+    uint32_t w[64];
+
+    for (; blocks; --blocks, data += SHA256_SW_BLOCK_SIZE) {
+        messageSchedule(data, w);
+        compression(hashVal, w);
+    }
+}
+
+/* CPU Features ---------------------------------------------------------------------- */
+
+#if HAVE_HWPROBE
+
+/* riscv_hwprobe(2), Linux 6.4 and later. AT_HWCAP only carries the single letter extensions */
+#define hwprobeSyscall      258
+#define hwprobeKeyImaExt0   4               // RISCV_HWPROBE_KEY_IMA_EXT_0
+#define hwprobeImaV         (1ULL << 2)     // RISCV_HWPROBE_IMA_V
+#define hwprobeExtZknh      (1ULL << 13)    // RISCV_HWPROBE_EXT_ZKNH
+#define hwprobeExtZvknha    (1ULL << 22)    // RISCV_HWPROBE_EXT_ZVKNHA
+#define hwprobeExtZvknhb    (1ULL << 23)    // RISCV_HWPROBE_EXT_ZVKNHB, a superset of Zvknha
+
+/* Extension bits of this CPU, 0 on kernels without riscv_hwprobe */
+static uint64_t hwprobe_extensions(void) {
+
+    struct { int64_t key; uint64_t value; } pair = { hwprobeKeyImaExt0, 0 };
+
+    if (syscall(hwprobeSyscall, &pair, 1, 0, NULL, 0) != 0)
+        return 0;
+    return pair.value;
+}
+
+#endif
+
+/* Zknh Backend ---------------------------------------------------------------------- */
+
+#if HAVE_ZKNH
+
+#define ZKNH_OP(insn, x) ({ uint32_t r_; __asm__(insn " %0, %1" : "=r"(r_) : "r"(x)); r_; })
+
+static void zknh_messageSchedule(const uint8_t *chunk, uint32_t w[64]) {
+
+    for (int i = 0; i < 16; ++i) {
+        w[i] = ((uint32_t)chunk[i * 4] << 24) | ((uint32_t)chunk[i * 4 + 1] << 16) |
+               ((uint32_t)chunk[i * 4 + 2] << 8) | (uint32_t)chunk[i * 4 + 3];
+    }
+
+    for (int i = 16; i < 64; ++i)
+        w[i] = w[i - 16] + ZKNH_OP("sha256sig0", w[i - 15]) + w[i - 7] + ZKNH_OP("sha256sig1", w[i - 2]);
+}
+
+static void zknh_compression(uint32_t hashVal[8], const uint32_t w[64]) {
+
+    uint32_t a = hashVal[0], b = hashVal[1], c = hashVal[2], d = hashVal[3];
+    uint32_t e = hashVal[4], f = hashVal[5], g = hashVal[6], h = hashVal[7];
+
+    for (int i = 0; i < 64; ++i) {
+        uint32_t temp1 = h + ZKNH_OP("sha256sum1", e) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+        uint32_t temp2 = ZKNH_OP("sha256sum0", a) + ((a & b) ^ (a & c) ^ (b & c));
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+
+    hashVal[0] += a;
+    hashVal[1] += b;
+    hashVal[2] += c;
+    hashVal[3] += d;
+    hashVal[4] += e;
+    hashVal[5] += f;
+    hashVal[6] += g;
+    hashVal[7] += h;
+}
+
+static void zknh_process_blocks(uint32_t hashVal[8], const uint8_t *data, size_t blocks) {
+
+    uint32_t w[64];
+
+    for (; blocks; --blocks, data += SHA256_SW_BLOCK_SIZE) {
+        zknh_messageSchedule(data, w);
+        zknh_compression(hashVal, w);
+    }
+}
+
+static int zknh_available(void) {
+    return (hwprobe_extensions() & hwprobeExtZknh) != 0;
+}
+
+#endif
+
+/* Zvknha Backend -------------------------------------------------------------------- */
+
+#if HAVE_ZVKNHA
+
+/* sha256_zvknha.c, compiled for the vector extension */
+void sha256_zvknha_blocks(uint32_t hashVal[8], const uint8_t *data, size_t blocks);
+
+static int zvknha_available(void) {
+
+    uint64_t ext = hwprobe_extensions();
+
+    return (ext & hwprobeImaV) && (ext & (hwprobeExtZvknha | hwprobeExtZvknhb));
+}
+
+#endif
+
+/* Backend Selection ----------------------------------------------------------------- */
+
+typedef struct {
+    const char *name;
+    void (*process_blocks)(uint32_t hashVal[8], const uint8_t *data, size_t blocks);
+    int (*available)(void);                 // NULL when every CPU can run it
+} sha256_sw_backend;
+
+/* Fastest first, the automatic choice is the first available one */
+static const sha256_sw_backend backends[] = {
+#if HAVE_ZVKNHA
+    { "zvknha", sha256_zvknha_blocks, zvknha_available },
+#endif
+#if HAVE_ZKNH
+    { "zknh", zknh_process_blocks, zknh_available },
+#endif
+    { "portable", portable_process_blocks, NULL },
+};
+
+static const sha256_sw_backend *activeBackend;
+
+int sha256_sw_select(const char *name) {
+
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); ++i) {
+        if (name && strcmp(name, "auto") && strcmp(name, backends[i].name))
+            continue;
+        if (backends[i].available && !backends[i].available()) {
+            if (name && strcmp(name, "auto"))
+                return -1;
+            continue;
+        }
+        activeBackend = &backends[i];
+        return 0;
+    }
+    return -1;
+}
+
+const char *sha256_sw_backend_name(void) {
+
+    if (!activeBackend)
+        sha256_sw_select(NULL);
+    return activeBackend->name;
+}
+
+static void process_blocks(sha256_sw *ctx, const uint8_t *data, size_t blocks) {
+
+    activeBackend->process_blocks(ctx->hashVal, data, blocks);
+}
+
+/* Streaming Interface --------------------------------------------------------------- */
+
+void sha256_sw_init(sha256_sw *ctx) {
+
+    if (!activeBackend)
+        sha256_sw_select(NULL);
+    memcpy(ctx->hashVal, initialHashVal, sizeof(initialHashVal));
+    ctx->blockLen = 0;
+    ctx->totalLen = 0;
+}
+
+void sha256_sw_update(sha256_sw *ctx, const void *data, size_t len) {
+
+    const uint8_t *p = data;
+
+    ctx->totalLen += len;
+
+    if (ctx->blockLen) {
+        size_t n = SHA256_SW_BLOCK_SIZE - ctx->blockLen;
+
+        if (n > len)
+            n = len;
+        memcpy(ctx->block + ctx->blockLen, p, n);
+        ctx->blockLen += n;
+        p += n;
+        len -= n;
+        if (ctx->blockLen < SHA256_SW_BLOCK_SIZE)
+            return;
+        process_blocks(ctx, ctx->block, 1);
+        ctx->blockLen = 0;
+    }
+
+    // All whole blocks in one call, the vector backend keeps its constants loaded across them
+    if (len >= SHA256_SW_BLOCK_SIZE) {
+        size_t blocks = len / SHA256_SW_BLOCK_SIZE;
+
+        process_blocks(ctx, p, blocks);
+        p += blocks * SHA256_SW_BLOCK_SIZE;
+        len -= blocks * SHA256_SW_BLOCK_SIZE;
+    }
+
+    memcpy(ctx->block, p, len);
+    ctx->blockLen = len;
+}
+
+void sha256_sw_final(sha256_sw *ctx, uint8_t out[SHA256_SW_DIGEST_SIZE]) {
+
+    uint64_t length = ctx->totalLen * 8;
+
+    // Append a single 1 bit, then zeros up to the 64-bit big endian length
+    ctx->block[ctx->blockLen++] = 0x80;
+    if (ctx->blockLen > SHA256_SW_BLOCK_SIZE - 8) {
+        memset(ctx->block + ctx->blockLen, 0, SHA256_SW_BLOCK_SIZE - ctx->blockLen);
+        process_blocks(ctx, ctx->block, 1);
+        ctx->blockLen = 0;
+    }
+    memset(ctx->block + ctx->blockLen, 0, SHA256_SW_BLOCK_SIZE - 8 - ctx->blockLen);
+    for (int i = 0; i < 8; ++i)
+        ctx->block[SHA256_SW_BLOCK_SIZE - 8 + i] = (length >> ((7 - i) * 8)) & 0xFF;
+    process_blocks(ctx, ctx->block, 1);
+
+    for (int i = 0; i < 8; ++i) {
+        out[i * 4] = (ctx->hashVal[i] >> 24) & 0xFF;
+        out[i * 4 + 1] = (ctx->hashVal[i] >> 16) & 0xFF;
+        out[i * 4 + 2] = (ctx->hashVal[i] >> 8) & 0xFF;
+        out[i * 4 + 3] = ctx->hashVal[i] & 0xFF;
+    }
+}
+
+void sha256_sw_batch(const void *const msgs[], const size_t lens[], uint8_t digests[][SHA256_SW_DIGEST_SIZE],
+                     size_t count) {
+
+    sha256_sw ctx;
+
+    for (size_t i = 0; i < count; ++i) {
+        sha256_sw_init(&ctx);
+        sha256_sw_update(&ctx, msgs[i], lens[i]);
+        sha256_sw_final(&ctx, digests[i]);
+    }
+}
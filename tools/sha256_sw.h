@@ -0,0 +1,57 @@
+/**
+ ****************************************************************************************
+ * @file    sha256_sw.h
+ * @brief   Streaming software SHA-256, the compression function of the lab1 reference
+ *          implementation (lab_experience/lab1/sha256_algorithm.c) without the per-chunk
+ *          allocations, so it can hash files of any size in constant memory.
+ ****************************************************************************************
+ */
+
+#ifndef SHA256_SW_H
+#define SHA256_SW_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_SW_DIGEST_SIZE   32
+#define SHA256_SW_BLOCK_SIZE    64
+
+typedef struct sha256_sw {
+    uint32_t hashVal[8];                        // Running hash values
+    uint8_t block[SHA256_SW_BLOCK_SIZE];        // Partial block carried between updates
+    size_t blockLen;
+    uint64_t totalLen;                          // Message length in bytes
+} sha256_sw;
+
+/**
+ * @brief Selects the compression backend: "portable", "zknh" (RISC-V scalar crypto),
+ * "zvknha" (RISC-V vector crypto) or NULL / "auto" for the fastest one this CPU supports,
+ * which is also the default.
+ *
+ * @return returns 0, or -1 if the backend is unknown or not supported by this CPU.
+ */
+int sha256_sw_select(const char *name);
+
+const char *sha256_sw_backend_name(void);
+
+void sha256_sw_init(sha256_sw *ctx);
+
+/**
+ * @brief Feeds the next part of the message, full blocks are compressed straight from
+ * the caller's buffer.
+ */
+void sha256_sw_update(sha256_sw *ctx, const void *data, size_t len);
+
+/**
+ * @brief Pads the message and writes the big endian digest.
+ */
+void sha256_sw_final(sha256_sw *ctx, uint8_t out[SHA256_SW_DIGEST_SIZE]);
+
+/**
+ * @brief Digests of count independent messages, one call for a whole batch of small
+ * records.
+ */
+void sha256_sw_batch(const void *const msgs[], const size_t lens[], uint8_t digests[][SHA256_SW_DIGEST_SIZE],
+                     size_t count);
+
+#endif
@@ -0,0 +1,290 @@
+/**
+ ****************************************************************************************
+ * @file    sha256_swhash.c
+ * @brief   Multi-threaded software SHA-256 of many files or directory trees, the software
+ *          baseline the accelerator is compared against. Prints sha256sum compatible
+ *          lines and the aggregate throughput.
+ ****************************************************************************************
+ * @attention
+ * Usage: sha256_swhash [-j threads] [-b backend] [-q] path...
+ *
+ * The backend is "auto" (default), "portable", "zknh" or "zvknha", see sha256_sw_select().
+ *
+ * Directories are walked recursively, symbolic links are not followed. Every file is one
+ * task of a work-stealing pool: tasks are dealt round robin to per-thread deques, largest
+ * first, a thread pops from the front of its own deque and steals from the back of the
+ * others when it runs dry.
+ *
+ * A SHA-256 digest cannot be computed in parallel, so a large file is one sequential
+ * stream owned by the thread that took it. Files up to mmapLimit are mapped with
+ * MADV_SEQUENTIAL, bigger ones are read in streamChunk pieces after a
+ * POSIX_FADV_SEQUENTIAL hint and dropped from the page cache behind the reader.
+ */
+
+/* Includes -------------------------------------------------------------------------- */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sha256_sw.h"
+
+#define mmapLimit       (64UL << 20)        // Larger files are streamed with read()
+#define streamChunk     (1UL << 20)         // read() size of the streaming path
+#define maxThreads      256
+
+typedef struct {
+    char *path;
+    off_t size;
+    uint8_t digest[SHA256_SW_DIGEST_SIZE];
+    int error;                              // errno of the failed step, 0 on success
+} HashTask;
+
+typedef struct {
+    pthread_mutex_t lock;
+    int *tasks;                             // Indices into the task list
+    int head, tail;                         // Owner pops at head, thieves take from tail
+} TaskDeque;
+
+static HashTask *taskList;
+static int numTasks, capTasks;
+static TaskDeque *deques;
+static int numThreads;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Task Collection ------------------------------------------------------------------- */
+
+static void add_task(const char *path, off_t size) {
+
+    if (numTasks == capTasks) {
+        capTasks = capTasks ? capTasks * 2 : 1024;
+        taskList = realloc(taskList, capTasks * sizeof(*taskList));
+    }
+    taskList[numTasks].path = strdup(path);
+    taskList[numTasks].size = size;
+    taskList[numTasks].error = 0;
+    numTasks++;
+}
+
+static int collect_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+
+    (void)ftw;
+    if (type == FTW_F && S_ISREG(st->st_mode))
+        add_task(path, st->st_size);
+    else if (type == FTW_DNR || type == FTW_NS)
+        fprintf(stderr, "sha256_swhash: %s: cannot access\n", path);
+    return 0;
+}
+
+static int cmp_size_desc(const void *a, const void *b) {
+    off_t x = taskList[*(const int *)a].size, y = taskList[*(const int *)b].size;
+    return (x < y) - (x > y);
+}
+
+/* Hashing --------------------------------------------------------------------------- */
+
+static int hash_mapped(int fd, off_t size, sha256_sw *ctx) {
+
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (map == MAP_FAILED)
+        return -1;
+    madvise(map, size, MADV_SEQUENTIAL);
+    sha256_sw_update(ctx, map, size);
+    munmap(map, size);
+    return 0;
+}
+
+static int hash_streamed(int fd, uint8_t *buf, sha256_sw *ctx) {
+
+    off_t done = 0;
+    ssize_t n;
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    while ((n = read(fd, buf, streamChunk)) > 0) {
+        sha256_sw_update(ctx, buf, n);
+        posix_fadvise(fd, done, n, POSIX_FADV_DONTNEED);     // Do not evict the other files
+        done += n;
+    }
+    return n < 0 ? -1 : 0;
+}
+
+static void hash_task(HashTask *t, uint8_t *buf) {
+
+    sha256_sw ctx;
+    int fd = open(t->path, O_RDONLY | O_CLOEXEC);
+    int rc;
+
+    if (fd < 0) {
+        t->error = errno;
+        return;
+    }
+
+    sha256_sw_init(&ctx);
+    if (t->size == 0)
+        rc = 0;
+    else if (t->size <= (off_t)mmapLimit && hash_mapped(fd, t->size, &ctx) == 0)
+        rc = 0;
+    else
+        rc = hash_streamed(fd, buf, &ctx);      // Also the fallback when mmap fails
+
+    if (rc)
+        t->error = errno;
+    else
+        sha256_sw_final(&ctx, t->digest);
+    close(fd);
+}
+
+/* Work-Stealing Pool ---------------------------------------------------------------- */
+
+static int pop_own(TaskDeque *d) {
+
+    int task = -1;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->head < d->tail)
+        task = d->tasks[d->head++];
+    pthread_mutex_unlock(&d->lock);
+    return task;
+}
+
+static int steal(TaskDeque *d) {
+
+    int task = -1;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->head < d->tail)
+        task = d->tasks[--d->tail];
+    pthread_mutex_unlock(&d->lock);
+    return task;
+}
+
+static void *worker(void *arg) {
+
+    int self = (int)(intptr_t)arg;
+    uint8_t *buf = malloc(streamChunk);
+    int task;
+
+    while (true) {
+        task = pop_own(&deques[self]);
+        // Tasks are never added after the start, so one empty sweep means done
+        for (int i = 1; task < 0 && i < numThreads; ++i)
+            task = steal(&deques[(self + i) % numThreads]);
+        if (task < 0)
+            break;
+        hash_task(&taskList[task], buf);
+    }
+
+    free(buf);
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+
+    pthread_t threads[maxThreads];
+    int quiet = 0, failures = 0, opt;
+    int *order;
+    uint64_t bytes = 0;
+    double start, elapsed;
+
+    numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    while ((opt = getopt(argc, argv, "j:b:q")) != -1) {
+        switch (opt) {
+            case 'j':
+                numThreads = atoi(optarg);
+                break;
+            case 'b':
+                if (sha256_sw_select(optarg)) {
+                    fprintf(stderr, "sha256_swhash: backend %s is not supported here\n", optarg);
+                    return 2;
+                }
+                break;
+            case 'q':
+                quiet = 1;
+                break;
+            default:
+                numThreads = 0;                 // Reported as usage below
+                break;
+        }
+    }
+    if (optind >= argc || numThreads < 1 || numThreads > maxThreads) {
+        fprintf(stderr, "usage: %s [-j threads] [-b backend] [-q] path...\n", argv[0]);
+        return 2;
+    }
+
+    for (int i = optind; i < argc; ++i) {
+        if (nftw(argv[i], collect_entry, 32, FTW_PHYS) != 0) {
+            fprintf(stderr, "sha256_swhash: %s: %s\n", argv[i], strerror(errno));
+            failures++;
+        }
+    }
+    if (numThreads > numTasks)
+        numThreads = numTasks ? numTasks : 1;
+
+    // Largest first, so the long sequential streams do not end up as the tail
+    order = malloc((numTasks + 1) * sizeof(*order));
+    for (int i = 0; i < numTasks; ++i)
+        order[i] = i;
+    qsort(order, numTasks, sizeof(*order), cmp_size_desc);
+
+    deques = calloc(numThreads, sizeof(*deques));
+    for (int t = 0; t < numThreads; ++t) {
+        pthread_mutex_init(&deques[t].lock, NULL);
+        deques[t].tasks = malloc((numTasks / numThreads + 1) * sizeof(int));
+    }
+    for (int i = 0; i < numTasks; ++i) {
+        TaskDeque *d = &deques[i % numThreads];
+        d->tasks[d->tail++] = order[i];
+    }
+
+    start = now_ns();
+    for (int t = 0; t < numThreads; ++t)
+        pthread_create(&threads[t], NULL, worker, (void *)(intptr_t)t);
+    for (int t = 0; t < numThreads; ++t)
+        pthread_join(threads[t], NULL);
+    elapsed = now_ns() - start;
+
+    for (int i = 0; i < numTasks; ++i) {
+        HashTask *t = &taskList[i];
+
+        if (t->error) {
+            fprintf(stderr, "sha256_swhash: %s: %s\n", t->path, strerror(t->error));
+            failures++;
+        } else {
+            bytes += t->size;
+            if (!quiet) {
+                for (int j = 0; j < SHA256_SW_DIGEST_SIZE; ++j)
+                    printf("%02x", t->digest[j]);
+                printf("  %s\n", t->path);
+            }
+        }
+        free(t->path);
+    }
+
+    fprintf(stderr, "%d file(s), %" PRIu64 " bytes, %d thread(s), %s: %.3f s, %.2f MB/s\n", numTasks, bytes,
+            numThreads, sha256_sw_backend_name(), elapsed / 1e9, elapsed > 0 ? bytes / (elapsed / 1e9) / 1e6 : 0.0);
+
+    for (int t = 0; t < numThreads; ++t)
+        free(deques[t].tasks);
+    free(deques);
+    free(order);
+    free(taskList);
+    return failures ? 1 : 0;
+}
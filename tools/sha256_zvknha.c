@@ -0,0 +1,142 @@
+/**
+ ****************************************************************************************
+ * @file    sha256_zvknha.c
+ * @brief   SHA-256 compression on the RISC-V vector crypto instructions (Zvknha):
+ *          vsha2ms expands the message schedule four words at a time and vsha2cl/ch
+ *          run two rounds each on the state held in two 4 x 32 bit element groups.
+ ****************************************************************************************
+ * @attention
+ * Built with -march=rv64gcv_zvknha on RISC-V only, see the Makefile. Nothing in here may
+ * run before sha256_sw.c has seen V and Zvknha (or Zvknhb) in riscv_hwprobe, which is
+ * also why this file is kept apart: the compiler may vectorize any of its C code.
+ *
+ * The input is byte swapped with vrgather so that only V and Zvknha are needed, not
+ * Zvkb. Register use: v0 mask, v1 swap indices, v2/v3 state, v4/v5 state at block start,
+ * v6 scratch, v10-v13 message schedule, v16-v31 round constants.
+ */
+
+/* Includes -------------------------------------------------------------------------- */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sha256_sw.h"
+
+#if defined(__riscv_zvknha)
+
+static const uint32_t k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/* Big endian words of a 16 byte group */
+static const uint8_t swapIndex[16] = { 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 };
+
+/* Four rounds on W[4q..4q+3] in w0, then w0 becomes W[4q+16..4q+19] */
+#define QUAD(w0, w1, w2, w3, kq) \
+    "vadd.vv v6, " w0 ", " kq "\n\t" \
+    "vsha2cl.vv v3, v2, v6\n\t" \
+    "vsha2ch.vv v2, v3, v6\n\t" \
+    "vmerge.vvm v6, " w2 ", " w1 ", v0\n\t" \
+    "vsha2ms.vv " w0 ", v6, " w3 "\n\t"
+
+/* Last four quads, the schedule is complete */
+#define QUAD_LAST(w0, kq) \
+    "vadd.vv v6, " w0 ", " kq "\n\t" \
+    "vsha2cl.vv v3, v2, v6\n\t" \
+    "vsha2ch.vv v2, v3, v6\n\t"
+
+#define LOAD_SWAPPED(w) \
+    "vle8.v v6, (%[data])\n\t" \
+    "vrgather.vv " w ", v6, v1\n\t" \
+    "addi %[data], %[data], 16\n\t"
+
+void sha256_zvknha_blocks(uint32_t hashVal[8], const uint8_t *data, size_t blocks) {
+
+    // Element groups hold {f, e, b, a} and {h, g, d, c}, element 0 first
+    uint32_t feba[4] = { hashVal[5], hashVal[4], hashVal[1], hashVal[0] };
+    uint32_t hgdc[4] = { hashVal[7], hashVal[6], hashVal[3], hashVal[2] };
+    const uint32_t *kp = k;
+
+    if (blocks == 0)
+        return;
+
+    __asm__ volatile(
+        "vsetivli zero, 1, e8, m1, ta, ma\n\t"
+        "vmv.v.i v0, 1\n\t"                                 // vmerge takes element 0 from the second source
+        "vsetivli zero, 16, e8, m1, ta, ma\n\t"
+        "vle8.v v1, (%[swap])\n\t"
+        "vsetivli zero, 4, e32, m1, ta, ma\n\t"
+        "vle32.v v2, (%[feba])\n\t"
+        "vle32.v v3, (%[hgdc])\n\t"
+        "vle32.v v16, (%[k])\n\t" "addi %[k], %[k], 16\n\t"
+        "vle32.v v17, (%[k])\n\t" "addi %[k], %[k], 16\n\t"
+        "vle32.v v18, (%[k])\n\t" "addi %[k], %[k], 16\n\t"
+        "vle32.v v19, (%[k])\n\t" "addi %[k], %[k], 16\n\t"
+        "vle32.v v20, (%[k])\n\t" "addi %[k], %[k], 16\n\t"
+        "vle32.v v21, (%[k])\n\t" "addi %[k], %[k], 16\n\t"
+        "vle32.v v22, (%[k])\n\t" "addi %[k], %[k], 16\n\t"
+        "vle32.v v23, (%[k])\n\t" "addi %[k], %[k], 16\n\t"
+        "vle32.v v24, (%[k])\n\t" "addi %[k], %[k], 16\n\t"
+        "vle32.v v25, (%[k])\n\t" "addi %[k], %[k], 16\n\t"
+        "vle32.v v26, (%[k])\n\t" "addi %[k], %[k], 16\n\t"
+        "vle32.v v27, (%[k])\n\t" "addi %[k], %[k], 16\n\t"
+        "vle32.v v28, (%[k])\n\t" "addi %[k], %[k], 16\n\t"
+        "vle32.v v29, (%[k])\n\t" "addi %[k], %[k], 16\n\t"
+        "vle32.v v30, (%[k])\n\t" "addi %[k], %[k], 16\n\t"
+        "vle32.v v31, (%[k])\n\t"
+
+        "1:\n\t"
+        "vmv.v.v v4, v2\n\t"
+        "vmv.v.v v5, v3\n\t"
+        "vsetivli zero, 16, e8, m1, ta, ma\n\t"
+        LOAD_SWAPPED("v10") LOAD_SWAPPED("v11") LOAD_SWAPPED("v12") LOAD_SWAPPED("v13")
+        "vsetivli zero, 4, e32, m1, ta, ma\n\t"
+
+        QUAD("v10", "v11", "v12", "v13", "v16")
+        QUAD("v11", "v12", "v13", "v10", "v17")
+        QUAD("v12", "v13", "v10", "v11", "v18")
+        QUAD("v13", "v10", "v11", "v12", "v19")
+        QUAD("v10", "v11", "v12", "v13", "v20")
+        QUAD("v11", "v12", "v13", "v10", "v21")
+        QUAD("v12", "v13", "v10", "v11", "v22")
+        QUAD("v13", "v10", "v11", "v12", "v23")
+        QUAD("v10", "v11", "v12", "v13", "v24")
+        QUAD("v11", "v12", "v13", "v10", "v25")
+        QUAD("v12", "v13", "v10", "v11", "v26")
+        QUAD("v13", "v10", "v11", "v12", "v27")
+        QUAD_LAST("v10", "v28")
+        QUAD_LAST("v11", "v29")
+        QUAD_LAST("v12", "v30")
+        QUAD_LAST("v13", "v31")
+
+        "vadd.vv v2, v2, v4\n\t"
+        "vadd.vv v3, v3, v5\n\t"
+        "addi %[blocks], %[blocks], -1\n\t"
+        "bnez %[blocks], 1b\n\t"
+
+        "vse32.v v2, (%[feba])\n\t"
+        "vse32.v v3, (%[hgdc])\n\t"
+        : [data] "+r"(data), [blocks] "+r"(blocks), [k] "+r"(kp)
+        : [swap] "r"(swapIndex), [feba] "r"(feba), [hgdc] "r"(hgdc)
+        : "memory", "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v10", "v11", "v12", "v13",
+          "v16", "v17", "v18", "v19", "v20", "v21", "v22", "v23",
+          "v24", "v25", "v26", "v27", "v28", "v29", "v30", "v31");
+
+    hashVal[0] = feba[3];
+    hashVal[1] = feba[2];
+    hashVal[4] = feba[1];
+    hashVal[5] = feba[0];
+    hashVal[2] = hgdc[3];
+    hashVal[3] = hgdc[2];
+    hashVal[6] = hgdc[1];
+    hashVal[7] = hgdc[0];
+}
+
+#endif
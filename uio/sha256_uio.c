@@ -0,0 +1,243 @@
+/**
+ ****************************************************************************************
+ * @file    sha256_uio.c
+ * @brief   This file implements a kernel-bypass runtime for the SHA256 Accelerator Core.
+ *          Instead of lkm/sha_driver.c the device is bound to the generic uio_pdrv_genirq
+ *          driver and the registers are accessed straight from userspace.
+ ****************************************************************************************
+ * @attention
+ * Do not load sha_driver.ko, and boot the guest with
+ *
+ *     uio_pdrv_genirq.of_id=sha256_accelerator
+ *
+ * on the kernel command line (or load the module with that parameter) so that the
+ * device tree node of the accelerator is bound to UIO and shows up as /dev/uioN.
+ */
+
+/* Includes -------------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+
+#include "sha256_uio.h"
+
+/* Device Register Map --------------------------------------------------------------- */
+
+#define ID_REG      0x0000
+#define CAP_REG     0x0004          // Input window size in bytes
+#define CTRL_REG    0x0008
+#define STATUS_REG  0x000C
+#define INPUT_REG   0x0010
+#define OUTPUT_REG(dev) (INPUT_REG + (dev)->inputSize)
+#define LEN_REG(dev)    (OUTPUT_REG(dev) + SHA256_UIO_DIGEST_SIZE)
+#define QUEUES_REG(dev) (LEN_REG(dev) + 0x08)
+
+/* Device Macros Definitions --------------------------------------------------------- */
+
+#define deviceEN            0x00000001      // Start hashing the bank in deviceBANK
+#define deviceBANK          0x00000002
+#define deviceMORE          0x00000004      // More parts of the message follow, do not finalize
+#define deviceSELECT        0x00000008      // Map the bank in deviceBANK into the input window
+#define statusBUSY(bank)    (0x2 << ((bank) * 4))
+#define DEVICE_ID           0xFEEDCAFE
+#define defaultInputSize    1024            // Window size of device models without a capability register
+#define maxInputSize        0x10000
+#define extRegBlockSize     0x40
+#define minPageSize         0x1000
+#define pollLimit           100000000       // STATUS_REG reads before a job is declared lost
+
+/* Register Access ------------------------------------------------------------------- */
+
+static inline uint32_t reg_read(sha256_uio *dev, uint32_t off) {
+    return *(volatile uint32_t *)(dev->regs + off);
+}
+
+static inline void reg_write(sha256_uio *dev, uint32_t off, uint32_t val) {
+    *(volatile uint32_t *)(dev->regs + off) = val;
+}
+
+static int wait_bank(sha256_uio *dev, int bank) {
+
+    for (long i = 0; i < pollLimit; i++) {
+        if (!(reg_read(dev, STATUS_REG) & statusBUSY(bank))) {
+            __sync_synchronize();           // Order the output reads after the status read
+            return 0;
+        }
+    }
+    errno = ETIMEDOUT;
+    return -1;
+}
+
+/* Loads one part into the fill bank with word stores, the device takes LSB first */
+static void load_bank(sha256_uio *dev, const uint8_t *data, size_t len) {
+
+    for (size_t i = 0; i < len; i += 4) {
+        uint32_t word = 0;
+
+        memcpy(&word, data + i, len - i < 4 ? len - i : 4);
+        reg_write(dev, INPUT_REG + i, word);
+    }
+}
+
+/* Same sequence as sha256_launch_bank() in the driver */
+static int launch_bank(sha256_uio *dev, uint32_t len, int more) {
+
+    uint32_t bank = dev->fillBank ? deviceBANK : 0;
+
+    reg_write(dev, LEN_REG(dev), len);
+    __sync_synchronize();                   // The window and length must land before the start
+    reg_write(dev, CTRL_REG, deviceEN | bank | (more ? deviceMORE : 0));
+
+    dev->fillBank ^= 1;
+    reg_write(dev, CTRL_REG, deviceSELECT | (dev->fillBank ? deviceBANK : 0));
+    return wait_bank(dev, dev->fillBank);
+}
+
+/* Runtime --------------------------------------------------------------------------- */
+
+static int read_sysfs_ulong(const char *path, unsigned long *val) {
+
+    FILE *f = fopen(path, "r");
+    int ok;
+
+    if (!f)
+        return -1;
+    ok = fscanf(f, "%lx", val) == 1;
+    fclose(f);
+    return ok ? 0 : -1;
+}
+
+/* First /sys/class/uio/uioN whose name mentions the accelerator */
+static int find_uio(char *node, size_t size) {
+
+    DIR *dir = opendir("/sys/class/uio");
+    struct dirent *ent;
+    int found = -1;
+
+    if (!dir)
+        return -1;
+
+    while (found < 0 && (ent = readdir(dir))) {
+        char path[300], name[64] = "";
+        FILE *f;
+
+        if (strncmp(ent->d_name, "uio", 3) != 0)
+            continue;
+        snprintf(path, sizeof(path), "/sys/class/uio/%s/name", ent->d_name);
+        f = fopen(path, "r");
+        if (!f)
+            continue;
+        if (fgets(name, sizeof(name), f) && strstr(name, "sha256")) {
+            snprintf(node, size, "/dev/%s", ent->d_name);
+            found = 0;
+        }
+        fclose(f);
+    }
+    closedir(dir);
+
+    if (found < 0)
+        errno = ENODEV;
+    return found;
+}
+
+int sha256_uio_open(sha256_uio *dev, const char *path, unsigned int context) {
+
+    char node[300], sysfs[300];
+    unsigned long size;
+    uint32_t stride, queues;
+
+    memset(dev, 0, sizeof(*dev));
+    dev->fd = -1;
+
+    if (!path) {
+        if (find_uio(node, sizeof(node)))
+            return -1;
+        path = node;
+    }
+
+    // map0 is the register resource of the device tree node
+    snprintf(sysfs, sizeof(sysfs), "/sys/class/uio/%s/maps/map0/size", strrchr(path, '/') + 1);
+    if (read_sysfs_ulong(sysfs, &size))
+        return -1;
+
+    dev->fd = open(path, O_RDWR | O_SYNC);
+    if (dev->fd < 0)
+        return -1;
+
+    dev->map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, dev->fd, 0);
+    if (dev->map == MAP_FAILED) {
+        close(dev->fd);
+        return -1;
+    }
+    dev->mapSize = size;
+    dev->regs = dev->map;
+
+    if (reg_read(dev, ID_REG) != DEVICE_ID) {
+        sha256_uio_close(dev);
+        errno = ENODEV;
+        return -1;
+    }
+
+    // Discover the input window size, older models without CAP_REG read back 0xDEADBEEF
+    dev->inputSize = reg_read(dev, CAP_REG);
+    if (dev->inputSize == 0 || dev->inputSize > maxInputSize)
+        dev->inputSize = defaultInputSize;
+
+    // Contexts are laid out like the driver expects, see QUEUE_STRIDE in sha_driver.c
+    queues = reg_read(dev, QUEUES_REG(dev));
+    for (stride = minPageSize; stride < LEN_REG(dev) + extRegBlockSize; stride <<= 1)
+        ;
+    if (queues == 0 || queues > size / stride)
+        queues = 1;
+    if (context >= queues) {
+        sha256_uio_close(dev);
+        errno = EINVAL;
+        return -1;
+    }
+    dev->regs += (size_t)context * stride;
+
+    // Start from a known state with bank 0 in the input window
+    reg_write(dev, CTRL_REG, 0);
+    dev->fillBank = 0;
+    return 0;
+}
+
+int sha256_uio_digest(sha256_uio *dev, const void *data, size_t len, uint8_t out[SHA256_UIO_DIGEST_SIZE]) {
+
+    const uint8_t *p = data;
+
+    // Full windows go out as non-final parts while the other bank is loaded
+    while (len > dev->inputSize) {
+        load_bank(dev, p, dev->inputSize);
+        if (launch_bank(dev, dev->inputSize, 1))
+            return -1;
+        p += dev->inputSize;
+        len -= dev->inputSize;
+    }
+
+    load_bank(dev, p, len);
+    if (launch_bank(dev, len, 0) || wait_bank(dev, dev->fillBank ^ 1))
+        return -1;
+
+    for (int i = 0; i < SHA256_UIO_DIGEST_SIZE; i += 4) {
+        uint32_t word = reg_read(dev, OUTPUT_REG(dev) + i);
+        memcpy(out + i, &word, 4);
+    }
+    return 0;
+}
+
+void sha256_uio_close(sha256_uio *dev) {
+
+    if (dev->map && dev->map != MAP_FAILED)
+        munmap(dev->map, dev->mapSize);
+    if (dev->fd >= 0)
+        close(dev->fd);
+    dev->map = NULL;
+    dev->fd = -1;
+}
@@ -0,0 +1,49 @@
+/**
+ ****************************************************************************************
+ * @file    sha256_uio.h
+ * @brief   Userspace runtime for the SHA256 Accelerator Core bound to uio_pdrv_genirq.
+ *          The register page is mapped into the process and driven directly, completion
+ *          is detected by polling STATUS_REG, so a digest costs no system call at all.
+ ****************************************************************************************
+ */
+
+#ifndef SHA256_UIO_H
+#define SHA256_UIO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_UIO_DIGEST_SIZE  32
+
+typedef struct sha256_uio {
+    int fd;                             // /dev/uioN
+    volatile uint8_t *regs;             // Mapped register page of the selected context
+    void *map;                          // Whole mapping, as returned by mmap
+    size_t mapSize;
+    uint32_t inputSize;                 // Input window size read from CAP_REG
+    int fillBank;                       // Bank mapped into the input window
+} sha256_uio;
+
+/**
+ * @brief Finds the UIO device of the accelerator and maps its registers.
+ *
+ * @param dev Runtime handle to fill in.
+ * @param path "/dev/uioN" to use, or NULL to pick the first UIO device whose name
+ * contains "sha256".
+ * @param context Register page (context) to drive, 0 on a single-context device.
+ *
+ * @return returns 0 or -1 with errno set.
+ */
+int sha256_uio_open(sha256_uio *dev, const char *path, unsigned int context);
+
+/**
+ * @brief Hashes a message of any length, streaming it through the ping-pong banks and
+ * busy-polling for completion.
+ *
+ * @return returns 0 or -1 with errno set to ETIMEDOUT if the device never finished.
+ */
+int sha256_uio_digest(sha256_uio *dev, const void *data, size_t len, uint8_t out[SHA256_UIO_DIGEST_SIZE]);
+
+void sha256_uio_close(sha256_uio *dev);
+
+#endif
@@ -0,0 +1,132 @@
+/**
+ ****************************************************************************************
+ * @file    sha256_uio_bench.c
+ * @brief   Compares the per-digest cost of the UIO polling runtime with the character
+ *          device path of sha_driver.ko (write, SHA256_IOC_START_HASH, read). The
+ *          difference is the kernel overhead paid for every digest.
+ ****************************************************************************************
+ * @attention
+ * A device can only be bound to one of the two drivers at a time. Either run the tool
+ * twice, once per boot configuration, or give the guest two accelerators (e.g. the
+ * sysbus one bound to UIO and a sha256-pci one bound to sha_driver.ko).
+ *
+ *     sha256_uio_bench [--uio /dev/uioN] [--chardev /dev/sha2560] [--sizes 64,1024]
+ *                      [--iterations N]
+ */
+
+/* Includes -------------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+#include "sha256_uio.h"
+
+#define SHA256_IOC_MAGIC 'k'
+#define SHA256_IOC_START_HASH _IOW(SHA256_IOC_MAGIC, 2, int)
+
+#define maxSizes            16
+#define defaultIterations   2000
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int chardev_digest(int fd, const char *msg, size_t len, uint8_t out[SHA256_UIO_DIGEST_SIZE]) {
+
+    if (write(fd, msg, len) != (ssize_t)len)
+        return -1;
+    if (ioctl(fd, SHA256_IOC_START_HASH, NULL) == -1)
+        return -1;
+    return read(fd, out, SHA256_UIO_DIGEST_SIZE) == SHA256_UIO_DIGEST_SIZE ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+
+    const char *uioPath = NULL, *charPath = "/dev/sha2560";
+    size_t sizes[maxSizes] = { 64, 1024, 16384 };
+    int numSizes = 3, iterations = defaultIterations;
+    uint8_t uioOut[SHA256_UIO_DIGEST_SIZE], charOut[SHA256_UIO_DIGEST_SIZE];
+    sha256_uio uio;
+    int haveUio, charFd;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--uio") && i + 1 < argc) {
+            uioPath = argv[++i];
+        } else if (!strcmp(argv[i], "--chardev") && i + 1 < argc) {
+            charPath = argv[++i];
+        } else if (!strcmp(argv[i], "--iterations") && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--sizes") && i + 1 < argc) {
+            char *tok = strtok(argv[++i], ",");
+            for (numSizes = 0; tok && numSizes < maxSizes; tok = strtok(NULL, ","))
+                sizes[numSizes++] = strtoul(tok, NULL, 0);
+        } else {
+            fprintf(stderr, "usage: %s [--uio /dev/uioN] [--chardev path] [--sizes a,b,...] [--iterations N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    haveUio = sha256_uio_open(&uio, uioPath, 0) == 0;
+    if (!haveUio)
+        fprintf(stderr, "uio: not available (%s)\n", strerror(errno));
+    charFd = open(charPath, O_RDWR);
+    if (charFd < 0)
+        fprintf(stderr, "chardev: %s not available (%s)\n", charPath, strerror(errno));
+    if (!haveUio && charFd < 0)
+        return 1;
+
+    printf("%8s %14s %14s %14s\n", "bytes", "uio ns/digest", "char ns/digest", "kernel ns");
+    for (int s = 0; s < numSizes; s++) {
+        char *msg = malloc(sizes[s]);
+        double uioNs = 0, charNs = 0, t0;
+
+        memset(msg, 'a', sizes[s]);
+
+        if (haveUio) {
+            t0 = now_ns();
+            for (int i = 0; i < iterations; i++) {
+                if (sha256_uio_digest(&uio, msg, sizes[s], uioOut)) {
+                    perror("uio digest");
+                    return 1;
+                }
+            }
+            uioNs = (now_ns() - t0) / iterations;
+        }
+
+        if (charFd >= 0) {
+            t0 = now_ns();
+            for (int i = 0; i < iterations; i++) {
+                if (chardev_digest(charFd, msg, sizes[s], charOut)) {
+                    perror("chardev digest");
+                    return 1;
+                }
+            }
+            charNs = (now_ns() - t0) / iterations;
+        }
+
+        if (haveUio && charFd >= 0 && memcmp(uioOut, charOut, SHA256_UIO_DIGEST_SIZE)) {
+            fprintf(stderr, "digest mismatch between the two paths for %zu bytes\n", sizes[s]);
+            return 2;
+        }
+
+        printf("%8zu", sizes[s]);
+        haveUio ? printf(" %14.0f", uioNs) : printf(" %14s", "n/a");
+        charFd >= 0 ? printf(" %14.0f", charNs) : printf(" %14s", "n/a");
+        haveUio && charFd >= 0 ? printf(" %14.0f\n", charNs - uioNs) : printf(" %14s\n", "n/a");
+        free(msg);
+    }
+
+    if (haveUio)
+        sha256_uio_close(&uio);
+    if (charFd >= 0)
+        close(charFd);
+    return 0;
+}